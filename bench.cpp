@@ -0,0 +1,318 @@
+/*
+ * Copyright (C) 2024
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * This tool measures the time needed by the color map generators, the
+ * exporters, and (if built with Qt) the image functions of the GUI, and
+ * prints the results in CSV or JSON format.
+ */
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <functional>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+
+#include <getopt.h>
+
+#include "colormap.hpp"
+#include "export.hpp"
+
+#ifdef GENCOLORMAP_BENCH_GUI
+# include <QApplication>
+# include "colormapwidgets.hpp"
+# include "testwidget.hpp"
+#endif
+
+class result {
+public:
+    std::string group;
+    std::string name;
+    std::string size;
+    long long iterations;
+    double seconds; // per iteration
+};
+
+class benchmark {
+public:
+    double min_time = 0.2; // minimum total time per measurement in seconds
+    std::vector<result> results;
+
+    // Call f repeatedly until at least min_time has passed, and record the
+    // average time per call.
+    void run(const char* group, const char* name, const std::string& size, const std::function<void ()>& f)
+    {
+        typedef std::chrono::steady_clock clock;
+        f(); // warm up caches and lookup tables
+        long long iterations = 0;
+        clock::time_point start = clock::now();
+        double elapsed;
+        do {
+            f();
+            iterations++;
+            elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        } while (elapsed < min_time);
+        results.push_back({ group, name, size, iterations, elapsed / iterations });
+        fprintf(stderr, "%s %s %s: %g s\n", group, name, size.c_str(), elapsed / iterations);
+    }
+
+    void print_csv() const
+    {
+        printf("group,name,size,iterations,seconds\n");
+        for (const result& r : results)
+            printf("%s,%s,%s,%lld,%.9g\n", r.group.c_str(), r.name.c_str(), r.size.c_str(),
+                    r.iterations, r.seconds);
+    }
+
+    void print_json() const
+    {
+        printf("[\n");
+        for (size_t i = 0; i < results.size(); i++) {
+            const result& r = results[i];
+            printf("{\"group\": \"%s\", \"name\": \"%s\", \"size\": \"%s\", \"iterations\": %lld, \"seconds\": %.9g}%s\n",
+                    r.group.c_str(), r.name.c_str(), r.size.c_str(), r.iterations, r.seconds,
+                    i < results.size() - 1 ? "," : "");
+        }
+        printf("]\n");
+    }
+};
+
+class generator {
+public:
+    const char* name;
+    int (*function)(int n, ColorMap::Output colormap);
+};
+
+static const generator generators[] = {
+    { "BrewerSequential",       [](int n, ColorMap::Output cm) { return ColorMap::BrewerSequential(n, cm); } },
+    { "BrewerDiverging",        [](int n, ColorMap::Output cm) { return ColorMap::BrewerDiverging(n, cm); } },
+    { "BrewerQualitative",      [](int n, ColorMap::Output cm) { return ColorMap::BrewerQualitative(n, cm); } },
+    { "PUSequentialLightness",  [](int n, ColorMap::Output cm) { return ColorMap::PUSequentialLightness(n, cm); } },
+    { "PUSequentialSaturation", [](int n, ColorMap::Output cm) { return ColorMap::PUSequentialSaturation(n, cm); } },
+    { "PUSequentialRainbow",    [](int n, ColorMap::Output cm) { return ColorMap::PUSequentialRainbow(n, cm); } },
+    { "PUSequentialBlackBody",  [](int n, ColorMap::Output cm) { return ColorMap::PUSequentialBlackBody(n, cm); } },
+    { "PUSequentialMultiHue",   [](int n, ColorMap::Output cm) { return ColorMap::PUSequentialMultiHue(n, cm); } },
+    { "PUDivergingLightness",   [](int n, ColorMap::Output cm) { return ColorMap::PUDivergingLightness(n, cm); } },
+    { "PUDivergingSaturation",  [](int n, ColorMap::Output cm) { return ColorMap::PUDivergingSaturation(n, cm); } },
+    { "PUQualitativeHue",       [](int n, ColorMap::Output cm) { return ColorMap::PUQualitativeHue(n, cm); } },
+    { "CubeHelix",              [](int n, ColorMap::Output cm) { return ColorMap::CubeHelix(n, cm); } },
+    { "Moreland",               [](int n, ColorMap::Output cm) { return ColorMap::Moreland(n, cm); } },
+    { "McNames",                [](int n, ColorMap::Output cm) { return ColorMap::McNames(n, cm); } },
+};
+
+static const int sizes[] = { 16, 256, 4096, 65536, 1048576 };
+
+static void bench_generators(benchmark& b)
+{
+    for (int n : sizes) {
+        std::vector<unsigned char> colormap(3 * n);
+        for (const generator& g : generators) {
+            b.run("generator", g.name, std::to_string(n),
+                    [&]() { g.function(n, colormap.data()); });
+        }
+    }
+
+    // Editing one hue of a multi-hue map with 16 hues, as in the GUI
+    const int hues = 16;
+    float hue_values[hues], hue_positions[hues];
+    for (int i = 0; i < hues; i++) {
+        hue_values[i] = std::fmod(i * 0.4f, 6.2831853f);
+        hue_positions[i] = i / (hues - 1.0f);
+    }
+    ColorMap::Generator g0 = ColorMap::Generator::PUSequentialMultiHue(
+            ColorMap::PUSequentialMultiHueDefaultLightnessRange,
+            ColorMap::PUSequentialMultiHueDefaultSaturationRange,
+            ColorMap::PUSequentialMultiHueDefaultSaturation,
+            hues, hue_values, hue_positions);
+    hue_values[3] += 0.5f;
+    ColorMap::Generator g1 = ColorMap::Generator::PUSequentialMultiHue(
+            ColorMap::PUSequentialMultiHueDefaultLightnessRange,
+            ColorMap::PUSequentialMultiHueDefaultSaturationRange,
+            ColorMap::PUSequentialMultiHueDefaultSaturation,
+            hues, hue_values, hue_positions);
+    for (int n : sizes) {
+        std::vector<unsigned char> colormap(3 * n);
+        std::vector<unsigned char> clipped(n);
+        g0.Generate(n, colormap.data(), clipped.data());
+        b.run("generator", "PUSequentialMultiHueEditOneHue", std::to_string(n),
+                [&]() { g1.Update(n, colormap.data(), clipped.data(), g0); });
+    }
+}
+
+static void bench_exporters(benchmark& b)
+{
+    FILE* null = fopen(
+#ifdef _WIN32
+            "NUL",
+#else
+            "/dev/null",
+#endif
+            "wb");
+    for (int n : sizes) {
+        std::vector<unsigned char> colormap(3 * n);
+        ColorMap::CubeHelix(n, colormap.data());
+        const unsigned char* cm = colormap.data();
+        std::string s = std::to_string(n);
+        b.run("exporter", "ToCSV", s, [&]() { ColorMap::ToCSV(n, cm); });
+        b.run("exporter", "ToJSON", s, [&]() { ColorMap::ToJSON(n, cm); });
+        b.run("exporter", "ToPPM", s, [&]() { ColorMap::ToPPM(n, cm); });
+        if (null) {
+            b.run("exporter", "WriteCSV", s, [&]() { ColorMap::WriteCSV(null, n, cm); });
+            b.run("exporter", "WriteJSON", s, [&]() { ColorMap::WriteJSON(null, n, cm); });
+            b.run("exporter", "WritePPM", s, [&]() { ColorMap::WritePPM(null, n, cm); });
+            b.run("exporter", "WritePPMBinary", s, [&]() { ColorMap::WritePPMBinary(null, n, cm); });
+            b.run("exporter", "WritePNG", s, [&]() { ColorMap::WritePNG(null, n, cm); });
+        }
+    }
+    if (null)
+        fclose(null);
+}
+
+static void bench_apply(benchmark& b)
+{
+    unsigned char colormap[3 * 256];
+    ColorMap::CubeHelix(256, colormap);
+    for (int count : { 4096, 1048576, 16777216 }) {
+        std::vector<float> data(count);
+        for (int i = 0; i < count; i++)
+            data[i] = std::sin(i * 0.001f) * 0.5f + 0.5f;
+        std::vector<unsigned char> result(3 * size_t(count));
+        b.run("apply", "Apply", std::to_string(count),
+                [&]() { ColorMap::Apply(data.data(), count, 0.0f, 1.0f, colormap, 256, result.data()); });
+    }
+}
+
+#ifdef GENCOLORMAP_BENCH_GUI
+static void bench_gui(benchmark& b)
+{
+    const int image_sizes[][2] = { { 256, 32 }, { 1024, 64 }, { 4096, 256 } };
+    for (int n : { 256, 4096 }) {
+        QVector<unsigned char> colormap(3 * n);
+        ColorMap::CubeHelix(n, colormap.data());
+        for (const auto& size : image_sizes) {
+            b.run("gui", "ColorMapWidget::colorMapImage",
+                    std::to_string(n) + "@" + std::to_string(size[0]) + "x" + std::to_string(size[1]),
+                    [&]() { ColorMapWidget::colorMapImage(colormap, size[0], size[1]); });
+        }
+        ColorMapTestWidget test_widget;
+        b.run("gui", "ColorMapTestWidget::update", std::to_string(n),
+                [&]() { test_widget.update(colormap); });
+    }
+}
+#endif
+
+int main(int argc, char* argv[])
+{
+#ifdef GENCOLORMAP_BENCH_GUI
+    if (!getenv("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+#endif
+
+    struct option options[] = {
+        { "help",     no_argument,       0, 'H' },
+        { "format",   required_argument, 0, 'f' },
+        { "threads",  required_argument, 0, 'j' },
+        { "min-time", required_argument, 0, 'm' },
+        { "group",    required_argument, 0, 'g' },
+        { 0, 0, 0, 0 }
+    };
+
+    benchmark b;
+    bool json = false;
+    int threads = 1;
+    std::string group;
+    bool print_help = false;
+    for (;;) {
+        int c = getopt_long(argc, argv, "Hf:j:m:g:", options, NULL);
+        if (c == -1)
+            break;
+        switch (c) {
+        case 'H':
+            print_help = true;
+            break;
+        case 'f':
+            if (strcmp(optarg, "csv") == 0) {
+                json = false;
+            } else if (strcmp(optarg, "json") == 0) {
+                json = true;
+            } else {
+                fprintf(stderr, "Invalid argument for option -f|--format.\n");
+                return 1;
+            }
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            if (threads < 0) {
+                fprintf(stderr, "Invalid argument for option -j|--threads.\n");
+                return 1;
+            }
+            break;
+        case 'm':
+            b.min_time = atof(optarg);
+            break;
+        case 'g':
+            group = optarg;
+            break;
+        default:
+            return 1;
+        }
+    }
+    if (optind < argc) {
+        fprintf(stderr, "Invalid extra arguments.\n");
+        return 1;
+    }
+    if (print_help) {
+        printf("Usage: %s [option...]\n"
+                "Measures the performance of color map generation and export.\n"
+                "Prints the results to standard output and progress to standard error.\n"
+                "  [-f|--format=csv|json]              Set output format\n"
+                "  [-j|--threads=J]                    Set number of threads, 0 for all cores\n"
+                "  [-m|--min-time=SECONDS]             Set minimum time per measurement\n"
+                "  [-g|--group=generator|exporter|apply|gui] Only run one group\n"
+                "Defaults: format=csv, threads=1, min-time=0.2\n",
+                argv[0]);
+        return 0;
+    }
+
+    ColorMap::SetThreads(threads);
+    if (group.empty() || group == "generator")
+        bench_generators(b);
+    if (group.empty() || group == "exporter")
+        bench_exporters(b);
+    if (group.empty() || group == "apply")
+        bench_apply(b);
+#ifdef GENCOLORMAP_BENCH_GUI
+    if (group.empty() || group == "gui")
+        bench_gui(b);
+#endif
+
+    if (json)
+        b.print_json();
+    else
+        b.print_csv();
+    return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2024
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include "cache.hpp"
+
+namespace ColorMap {
+
+// Entries of other program versions are not used. Also increase the cache
+// number whenever the results of the color map computations or the entry file
+// format change within a version, so that old entries are not used anymore.
+static const char cache_version[] = "gencolormap " GENCOLORMAP_VERSION ", cache 1";
+
+static const char cache_magic[8] = { 'G', 'C', 'M', 'C', 'A', 'C', 'H', 'E' };
+
+// 64 bit FNV-1a hash
+static uint64_t hash(const std::string& s, uint64_t h = 0xcbf29ce484222325ULL)
+{
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static std::string entry_file_name(const std::string& directory, const std::string& description)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.gcm",
+            static_cast<unsigned long long>(hash(description, hash(cache_version))));
+    std::string file_name = directory;
+    if (!file_name.empty() && file_name.back() != '/'
+#ifdef _WIN32
+            && file_name.back() != '\\'
+#endif
+            )
+        file_name += '/';
+    return file_name + name;
+}
+
+bool CacheLoad(const std::string& directory, const std::string& description,
+        void* data, size_t size, int* clipped)
+{
+    FILE* f = fopen(entry_file_name(directory, description).c_str(), "rb");
+    if (!f)
+        return false;
+    std::string key = std::string(cache_version) + '\n' + description;
+    char magic[sizeof(cache_magic)];
+    uint64_t key_size, data_size;
+    int32_t entry_clipped;
+    std::vector<char> entry_key;
+    bool ok = fread(magic, sizeof(magic), 1, f) == 1
+        && std::memcmp(magic, cache_magic, sizeof(magic)) == 0
+        && fread(&key_size, sizeof(key_size), 1, f) == 1
+        && key_size == key.size();
+    if (ok) {
+        entry_key.resize(key_size);
+        ok = fread(entry_key.data(), 1, key_size, f) == key_size
+            && std::memcmp(entry_key.data(), key.data(), key_size) == 0
+            && fread(&entry_clipped, sizeof(entry_clipped), 1, f) == 1
+            && fread(&data_size, sizeof(data_size), 1, f) == 1
+            && data_size == size
+            && fread(data, 1, size, f) == size;
+    }
+    fclose(f);
+    if (ok)
+        *clipped = entry_clipped;
+    return ok;
+}
+
+bool CacheStore(const std::string& directory, const std::string& description,
+        const void* data, size_t size, int clipped)
+{
+    std::string file_name = entry_file_name(directory, description);
+    // The temporary file name must be unique among all processes and threads
+    // that use the cache directory
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%llx.%llx.tmp",
+            static_cast<unsigned long long>(std::chrono::steady_clock::now().time_since_epoch().count()),
+            static_cast<unsigned long long>(std::hash<std::thread::id>()(std::this_thread::get_id())));
+    std::string tmp_file_name = file_name + suffix;
+    FILE* f = fopen(tmp_file_name.c_str(), "wb");
+    if (!f)
+        return false;
+    std::string key = std::string(cache_version) + '\n' + description;
+    uint64_t key_size = key.size();
+    uint64_t data_size = size;
+    int32_t entry_clipped = clipped;
+    bool ok = fwrite(cache_magic, sizeof(cache_magic), 1, f) == 1
+        && fwrite(&key_size, sizeof(key_size), 1, f) == 1
+        && fwrite(key.data(), 1, key.size(), f) == key.size()
+        && fwrite(&entry_clipped, sizeof(entry_clipped), 1, f) == 1
+        && fwrite(&data_size, sizeof(data_size), 1, f) == 1
+        && fwrite(data, 1, size, f) == size;
+    ok = (fclose(f) == 0) && ok;
+    if (ok) {
+#ifdef _WIN32
+        // rename() does not replace existing files on Windows; an existing
+        // entry is just as good as the new one
+        std::remove(file_name.c_str());
+#endif
+        ok = (std::rename(tmp_file_name.c_str(), file_name.c_str()) == 0);
+    }
+    if (!ok)
+        std::remove(tmp_file_name.c_str());
+    return ok;
+}
+
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2024
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef COLORMAP_CACHE_HPP
+#define COLORMAP_CACHE_HPP
+
+#include <string>
+#include <cstddef>
+
+/*
+ * A persistent cache for computed color maps
+ *
+ * Color maps can be stored in a cache directory and loaded again later
+ * instead of computing them again. Each entry is identified by a description
+ * of everything the color map depends on, e.g. its type, all parameters, the
+ * number of colors, the output format, and the global settings. The entry
+ * file name is a hash of this description and the library version; the
+ * description itself is stored in the entry as well, so hash collisions are
+ * detected. Entries are written to a temporary file first and then renamed,
+ * so that several processes can use the same cache directory.
+ */
+
+namespace ColorMap {
+
+// Load the entry with the given description into data, which has the given
+// size in bytes, and store its number of clipped colors in clipped.
+// Return false if there is no valid entry of this size.
+bool CacheLoad(const std::string& directory, const std::string& description,
+        void* data, size_t size, int* clipped);
+
+// Store data of the given size in bytes together with its number of clipped
+// colors as the entry with the given description. Return false on error.
+bool CacheStore(const std::string& directory, const std::string& description,
+        const void* data, size_t size, int clipped);
+
+}
+
+#endif
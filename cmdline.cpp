@@ -23,17 +23,31 @@
  */
 
 #include <vector>
+#include <map>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <cmath>
+#include <cctype>
 
 #include <getopt.h>
+#ifdef _WIN32
+# include <io.h>
+# include <fcntl.h>
+#endif
 extern char *optarg;
 extern int optind;
+#ifndef __GLIBC__
+extern int optreset;
+#endif
 
 #include "colormap.hpp"
 #include "export.hpp"
+#include "cache.hpp"
 
 enum type {
     brewer_seq,
@@ -52,16 +66,45 @@ enum type {
     mcnames
 };
 
+enum input_type {
+    float32,
+    uint16
+};
+
 enum format {
     csv,
     json,
-    ppm
+    ppm,
+    ppm_binary,
+    png,
+    raw_rgb8,
+    raw_rgbf32,
+    glsl,
+    hlsl,
+    wgsl,
+    ktx2,
+    dds,
+    raw_rgba8,
+    raw_rgb565
 };
 
-int main(int argc, char* argv[])
-{
+// Options that affect the whole program, not a single color map
+class settings {
+public:
     bool print_version = false;
     bool print_help = false;
+    bool fast = false;
+    bool print_stats = false;
+    int threads = 1;
+    std::string batch_file;
+    std::string cache_dir; // empty if no cache is used
+    std::vector<std::string> sweeps; // NAME,FROM,TO,COUNT for each swept parameter
+    bool have_map_options = false; // whether options for a single color map were given
+};
+
+// The parameters of one color map, and where to write it
+class parameters {
+public:
     int format = csv;
     int type = brewer_seq;
     int n = 256;
@@ -81,13 +124,71 @@ int main(int argc, char* argv[])
     std::vector<float> hue_positions;
     float gamma = -1.0f;
     bool have_color0 = false;
-    unsigned char color0[3];
+    unsigned char color0[3] = { 0, 0, 0 };
     bool have_color1 = false;
-    unsigned char color1[3];
+    unsigned char color1[3] = { 0, 0, 0 };
     float periods = NAN;
+    bool stable_order = false;
+    std::string output_file; // empty for standard output
+    std::string apply_file; // empty if the color map is not applied to data
+    int input_type = float32;
+    float range_min = NAN;
+    float range_max = NAN;
+    long long width = -1;
+    long long height = -1;
+    unsigned char nan_color[3] = { 0, 0, 0 };
+    float max_delta_e = 1.0f; // for shader output
+    bool print_metrics = false;
+    std::string metrics_file; // empty if the steps are not written to a file
+
+    // Parse the options. Options that affect the whole program are only
+    // accepted if s is not NULL; they are stored in s. Return false on error.
+    bool parse(int argc, char* argv[], settings* s);
+
+    // Check the parameters and set defaults for the ones that were not given.
+    // Return false on error.
+    bool finish();
+
+    // Get a generator for the color map.
+    ColorMap::Generator generator() const;
+
+    // Generate the color map and return the number of clipped colors.
+    int generate(ColorMap::Output colormap) const;
+
+    // Print the perceptual uniformity metrics of the color map, and write
+    // its steps to the metrics file if there is one. Return false on error.
+    bool metrics() const;
+
+    // Describe everything the generated color map depends on, for the cache.
+    std::string cache_description(const settings& s) const;
+
+    // Apply the color map to the data file and write the result to f.
+    // Return false on error.
+    bool apply(const unsigned char* colormap, FILE* f) const;
+
+    // Generate the color map (or get it from the cache) and write it, or apply
+    // it to the data file and write the result. Print a message and return
+    // false on error.
+    bool run(int* clipped, const settings& s) const;
+};
+
+bool parameters::parse(int argc, char* argv[], settings* s)
+{
     struct option options[] = {
         { "version",           no_argument,       0, 'v' },
         { "help",              no_argument,       0, 'H' },
+        { "fast",              no_argument,       0, 'F' },
+        { "threads",           required_argument, 0, 'j' },
+        { "cache",             required_argument, 0, 'C' },
+        { "batch",             required_argument, 0, 'B' },
+        { "stats",             no_argument,       0, 'X' }, // no short option
+        { "sweep",             required_argument, 0, 'Y' }, // no short option
+        { "output",            required_argument, 0, 'o' },
+        { "apply",             required_argument, 0, 'a' },
+        { "input-type",        required_argument, 0, 'i' },
+        { "range",             required_argument, 0, 'm' },
+        { "dimensions",        required_argument, 0, 'D' },
+        { "nan-color",         required_argument, 0, 'N' },
         { "format",            required_argument, 0, 'f' },
         { "type",              required_argument, 0, 't' },
         { "n",                 required_argument, 0, 'n' },
@@ -109,24 +210,103 @@ int main(int argc, char* argv[])
         { "color0",            required_argument, 0, 'A' },
         { "color1",            required_argument, 0, 'O' },
         { "periods",           required_argument, 0, 'p' },
+        { "stable-order",      no_argument,       0, 'Q' }, // no short option
+        { "metrics",           optional_argument, 0, 'Z' }, // no short option
+        { "max-delta-e",       required_argument, 0, 'E' }, // no short option
         { 0, 0, 0, 0 }
     };
 
+    // This function is called for each line of a batch file, so getopt must
+    // start from scratch each time
+#ifdef __GLIBC__
+    optind = 0;
+#else
+    optind = 1;
+    optreset = 1;
+#endif
     for (;;) {
-        int c = getopt_long(argc, argv, "vHf:t:n:h:d:c:s:S:b:w:l:L:r:T:R:V:P::g:A:O:p:", options, NULL);
+        int c = getopt_long(argc, argv, "vHFj:C:B:o:a:i:m:D:N:f:t:n:h:d:c:s:S:b:w:l:L:r:T:R:V:P::g:A:O:p:", options, NULL);
         if (c == -1)
             break;
+        if (s && !strchr("vHFjCBXY", c))
+            s->have_map_options = true;
         switch (c) {
         case 'v':
-            print_version = true;
-            break;
         case 'H':
-            print_help = true;
+        case 'F':
+        case 'j':
+        case 'C':
+        case 'B':
+        case 'X':
+        case 'Y':
+            if (!s) {
+                if (c == 'X' || c == 'Y')
+                    fprintf(stderr, "Option --%s is not allowed in a batch file.\n", c == 'X' ? "stats" : "sweep");
+                else
+                    fprintf(stderr, "Option -%c is not allowed in a batch file.\n", c);
+                return false;
+            }
+            if (c == 'v')
+                s->print_version = true;
+            else if (c == 'H')
+                s->print_help = true;
+            else if (c == 'F')
+                s->fast = true;
+            else if (c == 'j')
+                s->threads = atoi(optarg);
+            else if (c == 'X')
+                s->print_stats = true;
+            else if (c == 'Y')
+                s->sweeps.push_back(optarg);
+            else if (c == 'C')
+                s->cache_dir = optarg;
+            else
+                s->batch_file = optarg;
+            break;
+        case 'o':
+            output_file = optarg;
+            break;
+        case 'a':
+            apply_file = optarg;
+            break;
+        case 'i':
+            input_type = (strcmp(optarg, "float32") == 0 ? float32
+                    : strcmp(optarg, "uint16") == 0 ? uint16
+                    : -1);
+            break;
+        case 'm':
+            // The bounds must be finite and differ by a finite amount so
+            // that the range can be divided into one interval per color
+            if (std::sscanf(optarg, "%f,%f", &range_min, &range_max) != 2
+                    || !std::isfinite(range_max - range_min) || range_min == range_max) {
+                fprintf(stderr, "Invalid argument for option -m|--range.\n");
+                return false;
+            }
+            break;
+        case 'D':
+            if (std::sscanf(optarg, "%lldx%lld", &width, &height) != 2 || width < 1 || height < 1) {
+                fprintf(stderr, "Invalid argument for option -D|--dimensions.\n");
+                return false;
+            }
+            break;
+        case 'N':
+            std::sscanf(optarg, "%hhu,%hhu,%hhu", nan_color + 0, nan_color + 1, nan_color + 2);
             break;
         case 'f':
             format = (strcmp(optarg, "csv") == 0 ? csv
                     : strcmp(optarg, "json") == 0 ? json
                     : strcmp(optarg, "ppm") == 0 ? ppm
+                    : strcmp(optarg, "ppm-binary") == 0 ? ppm_binary
+                    : strcmp(optarg, "png") == 0 ? png
+                    : strcmp(optarg, "raw-rgb8") == 0 ? raw_rgb8
+                    : strcmp(optarg, "raw-rgbf32") == 0 ? raw_rgbf32
+                    : strcmp(optarg, "glsl") == 0 ? glsl
+                    : strcmp(optarg, "hlsl") == 0 ? hlsl
+                    : strcmp(optarg, "wgsl") == 0 ? wgsl
+                    : strcmp(optarg, "ktx2") == 0 ? ktx2
+                    : strcmp(optarg, "dds") == 0 ? dds
+                    : strcmp(optarg, "raw-rgba8") == 0 ? raw_rgba8
+                    : strcmp(optarg, "raw-rgb565") == 0 ? raw_rgb565
                     : -1);
             break;
         case 't':
@@ -217,87 +397,67 @@ int main(int argc, char* argv[])
         case 'p':
             periods = atof(optarg);
             break;
+        case 'Q':
+            stable_order = true;
+            break;
+        case 'Z':
+            print_metrics = true;
+            if (optarg)
+                metrics_file = optarg;
+            break;
+        case 'E':
+            max_delta_e = atof(optarg);
+            break;
         default:
-            return 1;
+            return false;
         }
     }
-
-    if (print_version) {
-        printf("gencolormap version 2.4\n"
-                "https://marlam.de/gencolormap\n"
-                "Copyright (C) 2024 Computer Graphics Group, University of Siegen.\n"
-                "Written by Martin Lambers <martin.lambers@uni-siegen.de>.\n"
-                "This is free software under the terms of the MIT/Expat License.\n"
-                "There is NO WARRANTY, to the extent permitted by law.\n");
-        return 0;
-    }
-
-    if (print_help) {
-        printf("Usage: %s [option...]\n"
-                "Generates a color map and prints it to standard output.\n"
-                "Prints the number of colors that had to be clipped to standard error.\n"
-                "Common options:\n"
-                "  [-f|--format=csv|json|ppm]          Set output format\n"
-                "  [-n|--n=N]                          Set number of colors in the map\n"
-                "Brewer-like color maps:\n"
-                "  [-t|--type=brewer-sequential]       Generate a sequential color map\n"
-                "  [-t|--type=brewer-diverging]        Generate a diverging color map\n"
-                "  [-t|--type=brewer-qualitative]      Generate a qualitative color map\n"
-                "  [-h|--hue=H]                        Set default hue in [0,360] degrees\n"
-                "  [-c|--contrast=C]                   Set contrast in [0,1]\n"
-                "  [-s|--saturation=S]                 Set saturation in [0,1]\n"
-                "  [-b|--brightness=B]                 Set brightness in [0,1]\n"
-                "  [-w|--warmth=W]                     Set warmth in [0,1] for seq. and div. maps\n"
-                "  [-d|--divergence=D]                 Set diverg. in deg for div. and qual. maps\n"
-                "Perceptually uniform color maps:\n"
-                "  [-t|--type=pusequential-lightness]  Sequential map, varying lightness\n"
-                "  [-t|--type=pusequential-saturation] Sequential map, varying saturation\n"
-                "  [-t|--type=pusequential-rainbow]    Sequential map, varying hue (rainbow)\n"
-                "  [-t|--type=pusequential-blackbody]  Sequential map, varying hue (black body)\n"
-                "  [-t|--type=pusequential-multihue]   Sequential map, varying hue (custom)\n"
-                "  [-t|--type=pudiverging-lightness]   Diverging map, varying lightness\n"
-                "  [-t|--type=pudiverging-saturation]  Diverging map, varying saturation\n"
-                "  [-t|--type=puqualitative-hue]       Qualitative map, evenly distributed hue\n"
-                "  [-l|--lightness=L]                  Set lightness in [0,1]\n"
-                "  [-L|--lightness-range=LR]           Set lightness range in [0.7,1]\n"
-                "  [-s|--saturation=S]                 Set saturation in [0,1]\n"
-                "  [-S|--saturation-range=SR]          Set saturation range in [0.7,1]\n"
-                "  [-h|--hue=H]                        Set default hue in [0,360] degrees\n"
-                "  [-d|--divergence=D]                 Set diverg. in deg for div. and qual. maps\n"
-                "  [-r|--rotations=R]                  Set number of rotations for rainbow maps\n"
-                "  [-T|--temperature=T]                Set start temp. in K for black body maps\n"
-                "  [-R|--temperature-range=TR]         Set range for temperature in K\n"
-                "  [-V|--hue-values=H0,H1,...]         Set hue values in [0,360] for multi-hue maps\n"
-                "  [-P|--hue-positions=P0,P1,...]      Set hue positions in [0,1] for multi-hue maps\n"
-                "CubeHelix color maps:\n"
-                "  [-t|--type=cubehelix]               Generate a CubeHelix color map\n"
-                "  [-h|--hue=H]                        Set start hue in [0,180] degrees\n"
-                "  [-r|--rotations=R]                  Set number of rotations, in (-infty,infty)\n"
-                "  [-s|--saturation=S]                 Set saturation, in [0,1]\n"
-                "  [-g|--gamma=G]                      Set gamma correction, in (0,infty)\n"
-                "Moreland diverging color maps:\n"
-                "  [-t|--type=moreland]                Generate a Moreland diverging color map\n"
-                "  [-A|--color0=sr,sg,sb]              Set the first color as sRGB in [0,255]\n"
-                "  [-O|--color1=sr,sg,sb]              Set the last color as sRGB in [0,255]\n"
-                "McNames sequential color maps:\n"
-                "  [-t|--type=mcnames]                 Generate a McNames sequential color map\n"
-                "  [-p|--periods=P]                    Set the number of periods in (0, infty)\n"
-                "Defaults: format=csv, n=256, type=brewer-sequential\n"
-                "https://marlam.de/gencolormap\n", argv[0]);
-        return 0;
+    if (!s && optind < argc) {
+        fprintf(stderr, "Invalid argument %s.\n", argv[optind]);
+        return false;
     }
+    return true;
+}
 
+bool parameters::finish()
+{
     if (format < 0) {
         fprintf(stderr, "Invalid argument for option -f|--format.\n");
-        return 1;
+        return false;
     }
     if (n < 2) {
         fprintf(stderr, "Invalid argument for option -n|--n.\n");
-        return 1;
+        return false;
     }
     if (type < 0) {
         fprintf(stderr, "Invalid argument for option -t|--type.\n");
-        return 1;
+        return false;
+    }
+    if (input_type < 0) {
+        fprintf(stderr, "Invalid argument for option -i|--input-type.\n");
+        return false;
+    }
+    if (!(max_delta_e >= 0.0f)) {
+        fprintf(stderr, "Invalid argument for option --max-delta-e.\n");
+        return false;
+    }
+    if (stable_order && type != brewer_qual && type != puqual_hue) {
+        fprintf(stderr, "Option --stable-order requires a qualitative color map type.\n");
+        return false;
+    }
+    if (!apply_file.empty()) {
+        if (format != ppm_binary && format != raw_rgb8) {
+            fprintf(stderr, "Option -a|--apply requires format ppm-binary or raw-rgb8.\n");
+            return false;
+        }
+        if (format == ppm_binary && width < 0) {
+            fprintf(stderr, "Format ppm-binary requires option -D|--dimensions.\n");
+            return false;
+        }
+        if (std::isnan(range_min)) {
+            range_min = 0.0f;
+            range_max = (input_type == float32 ? 1.0f : 65535.0f);
+        }
     }
     if (hue < 0.0f) {
         if (type == brewer_seq)
@@ -453,7 +613,7 @@ int main(int argc, char* argv[])
     }
     if (hue_values.size() != hue_positions.size()) {
         fprintf(stderr, "Number of hue values and positions do not match.\n");
-        return 1;
+        return false;
     }
     if (!have_color0) {
         if (type == moreland) {
@@ -473,67 +633,757 @@ int main(int argc, char* argv[])
         if (type == mcnames)
             periods = ColorMap::McNamesDefaultPeriods;
     }
+    return true;
+}
 
-    std::vector<unsigned char> colormap(3 * n);
-    int clipped;
+ColorMap::Generator parameters::generator() const
+{
     switch (type) {
     case brewer_seq:
-        clipped = ColorMap::BrewerSequential(n, &(colormap[0]), hue, contrast, saturation, brightness, warmth);
-        break;
+        return ColorMap::Generator::BrewerSequential(hue, contrast, saturation, brightness, warmth);
     case brewer_div:
-        clipped = ColorMap::BrewerDiverging(n, &(colormap[0]), hue, divergence, contrast, saturation, brightness, warmth);
-        break;
+        return ColorMap::Generator::BrewerDiverging(hue, divergence, contrast, saturation, brightness, warmth);
     case brewer_qual:
-        clipped = ColorMap::BrewerQualitative(n, &(colormap[0]), hue, divergence, contrast, saturation, brightness);
-        break;
+        return ColorMap::Generator::BrewerQualitative(hue, divergence, contrast, saturation, brightness,
+                stable_order);
     case puseq_lightness:
-        clipped = ColorMap::PUSequentialLightness(n, &(colormap[0]), lightness_range, saturation_range, saturation, hue);
-        break;
+        return ColorMap::Generator::PUSequentialLightness(lightness_range, saturation_range, saturation, hue);
     case puseq_saturation:
-        clipped = ColorMap::PUSequentialSaturation(n, &(colormap[0]), saturation_range, lightness, saturation, hue);
-        break;
+        return ColorMap::Generator::PUSequentialSaturation(saturation_range, lightness, saturation, hue);
     case puseq_rainbow:
-        clipped = ColorMap::PUSequentialRainbow(n, &(colormap[0]), lightness_range, saturation_range, hue, rotations, saturation);
-        break;
+        return ColorMap::Generator::PUSequentialRainbow(lightness_range, saturation_range, hue, rotations, saturation);
     case puseq_blackbody:
-        clipped = ColorMap::PUSequentialBlackBody(n, &(colormap[0]), temperature, temperature_range, lightness_range, saturation_range, saturation);
-        break;
+        return ColorMap::Generator::PUSequentialBlackBody(temperature, temperature_range, lightness_range, saturation_range, saturation);
     case puseq_multihue:
-        clipped = ColorMap::PUSequentialMultiHue(n, &(colormap[0]), lightness_range, saturation_range, saturation,
+        return ColorMap::Generator::PUSequentialMultiHue(lightness_range, saturation_range, saturation,
                 hue_values.size(), hue_values.data(), hue_positions.data());
-        break;
     case pudiv_lightness:
-        clipped = ColorMap::PUDivergingLightness(n, &(colormap[0]), lightness_range, saturation_range, saturation, hue, divergence);
-        break;
+        return ColorMap::Generator::PUDivergingLightness(lightness_range, saturation_range, saturation, hue, divergence);
     case pudiv_saturation:
-        clipped = ColorMap::PUDivergingSaturation(n, &(colormap[0]), saturation_range, lightness, saturation, hue, divergence);
-        break;
+        return ColorMap::Generator::PUDivergingSaturation(saturation_range, lightness, saturation, hue, divergence);
     case puqual_hue:
-        clipped = ColorMap::PUQualitativeHue(n, &(colormap[0]), hue, divergence, lightness, saturation);
-        break;
+        return ColorMap::Generator::PUQualitativeHue(hue, divergence, lightness, saturation, stable_order);
     case cubehelix:
-        clipped = ColorMap::CubeHelix(n, &(colormap[0]), hue, rotations, saturation, gamma);
-        break;
+        return ColorMap::Generator::CubeHelix(hue, rotations, saturation, gamma);
     case moreland:
-        clipped = ColorMap::Moreland(n, &(colormap[0]),
+        return ColorMap::Generator::Moreland(
                 color0[0], color0[1], color0[2],
                 color1[0], color1[1], color1[2]);
-        break;
     case mcnames:
-        clipped = ColorMap::McNames(n, &(colormap[0]), periods);
-        break;
+    default:
+        return ColorMap::Generator::McNames(periods);
+    }
+}
+
+int parameters::generate(ColorMap::Output colormap) const
+{
+    return generator().Generate(n, colormap);
+}
+
+bool parameters::metrics() const
+{
+    std::vector<unsigned char> colormap(3 * n);
+    std::vector<unsigned char> clipped(n);
+    std::vector<float> delta_e76(n - 1);
+    std::vector<float> delta_e2000(n - 1);
+    generator().Generate(n, colormap.data(), clipped.data());
+    ColorMap::Metrics m = ColorMap::ComputeMetrics(n, colormap.data(), delta_e76.data(), delta_e2000.data());
+
+    // Print everything at once, since batch jobs run in parallel
+    std::string prefix = (output_file.empty() ? std::string() : output_file + ": ");
+    std::string report;
+    char buf[256];
+    auto add_steps = [&](const char* name, const ColorMap::MetricsSteps& st) {
+        snprintf(buf, sizeof(buf), "%s%s steps: min %.3f max %.3f mean %.3f stddev %.3f variation %.1f%% total %.1f\n",
+                prefix.c_str(), name, st.min, st.max, st.mean, st.stddev, st.variation * 100.0f, st.total);
+        report += buf;
+    };
+    add_steps("Delta E 1976", m.delta_e76);
+    add_steps("CIEDE2000", m.delta_e2000);
+    report += prefix + "clipped colors:";
+    bool any_clipped = false;
+    for (int i = 0; i < n;) {
+        if (!clipped[i]) {
+            i++;
+            continue;
+        }
+        int j = i + 1;
+        while (j < n && clipped[j])
+            j++;
+        if (j - 1 > i)
+            snprintf(buf, sizeof(buf), "%s %d-%d", any_clipped ? "," : "", i, j - 1);
+        else
+            snprintf(buf, sizeof(buf), "%s %d", any_clipped ? "," : "", i);
+        report += buf;
+        any_clipped = true;
+        i = j;
     }
+    report += (any_clipped ? "\n" : " none\n");
+    fputs(report.c_str(), stderr);
 
-    std::string output;
-    if (format == csv) {
-        output = ColorMap::ToCSV(n, colormap.data());
+    if (metrics_file.empty())
+        return true;
+    FILE* f = fopen(metrics_file.c_str(), "w");
+    if (!f) {
+        fprintf(stderr, "Cannot open %s.\n", metrics_file.c_str());
+        return false;
+    }
+    bool ok = (fputs("step,delta_e76,delta_e2000\n", f) >= 0);
+    for (int i = 0; ok && i < n - 1; i++)
+        ok = (fprintf(f, "%d,%.6f,%.6f\n", i, delta_e76[i], delta_e2000[i]) > 0);
+    if (fclose(f) != 0 || !ok) {
+        fprintf(stderr, "Cannot write %s.\n", metrics_file.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool parameters::apply(const unsigned char* colormap, FILE* f) const
+{
+    FILE* in = stdin;
+    if (apply_file == "-") {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    } else {
+        in = fopen(apply_file.c_str(), "rb");
+        if (!in) {
+            fprintf(stderr, "Cannot open %s.\n", apply_file.c_str());
+            return false;
+        }
+    }
+
+    // Process the data in chunks so that memory usage does not depend on
+    // the size of the data
+    const size_t chunk_size = 1 << 20;
+    std::vector<unsigned short> data_uint16(input_type == uint16 ? chunk_size : 0);
+    std::vector<float> data(chunk_size);
+    std::vector<unsigned char> result(3 * chunk_size);
+    long long count = (width > 0 ? width * height : -1); // -1 means until end of file
+    long long processed = 0;
+    bool ok = true;
+    if (format == ppm_binary) {
+        std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+        ok = (fwrite(header.data(), 1, header.size(), f) == header.size());
+    }
+    // The values are read as bytes, so that a partial value at the end of
+    // the data can be detected
+    size_t value_size = (input_type == uint16 ? sizeof(unsigned short) : sizeof(float));
+    bool partial = false;
+    while (ok && processed != count) {
+        size_t m = chunk_size;
+        if (count >= 0)
+            m = std::min(static_cast<long long>(m), count - processed);
+        size_t bytes;
+        if (input_type == uint16) {
+            bytes = fread(data_uint16.data(), 1, m * value_size, in);
+            m = bytes / value_size;
+            for (size_t j = 0; j < m; j++)
+                data[j] = data_uint16[j];
+        } else {
+            bytes = fread(data.data(), 1, m * value_size, in);
+            m = bytes / value_size;
+        }
+        partial = (bytes % value_size != 0);
+        if (m == 0)
+            break;
+        ColorMap::Apply(data.data(), m, range_min, range_max, colormap, n, result.data(),
+                nan_color[0], nan_color[1], nan_color[2]);
+        ok = (fwrite(result.data(), 3, m, f) == m);
+        processed += m;
+        if (partial)
+            break;
+    }
+    if (ferror(in) || (count >= 0 && processed < count && !partial)) {
+        fprintf(stderr, "Cannot read %s.\n", apply_file.c_str());
+        ok = false;
+    } else if (partial) {
+        fprintf(stderr, "%s ends with an incomplete value.\n", apply_file.c_str());
+        ok = false;
+    } else if (ok && count >= 0 && fgetc(in) != EOF) {
+        fprintf(stderr, "%s contains more than %lldx%lld values.\n", apply_file.c_str(), width, height);
+        ok = false;
+    } else if (!ok) {
+        fprintf(stderr, "Cannot write output.\n");
+    }
+    if (in != stdin)
+        fclose(in);
+    return ok;
+}
+
+std::string parameters::cache_description(const settings& s) const
+{
+    // Floats are printed exactly in hexadecimal notation
+    std::string d;
+    char buf[64];
+    auto add = [&](const char* name, float v) {
+        snprintf(buf, sizeof(buf), " %s=%a", name, v);
+        d += buf;
+    };
+    snprintf(buf, sizeof(buf), "type=%d n=%d float=%d fast=%d", type, n, format == raw_rgbf32 ? 1 : 0, s.fast ? 1 : 0);
+    d += buf;
+    add("hue", hue);
+    add("divergence", divergence);
+    add("contrast", contrast);
+    add("saturation", saturation);
+    add("saturation_range", saturation_range);
+    add("brightness", brightness);
+    add("warmth", warmth);
+    add("lightness", lightness);
+    add("lightness_range", lightness_range);
+    add("rotations", rotations);
+    add("temperature", temperature);
+    add("temperature_range", temperature_range);
+    for (size_t i = 0; i < hue_values.size(); i++) {
+        add("hue_value", hue_values[i]);
+        add("hue_position", hue_positions[i]);
+    }
+    add("gamma", gamma);
+    snprintf(buf, sizeof(buf), " color0=%d,%d,%d color1=%d,%d,%d",
+            color0[0], color0[1], color0[2], color1[0], color1[1], color1[2]);
+    d += buf;
+    add("periods", periods);
+    if (stable_order)
+        d += " stable_order=1";
+    return d;
+}
+
+// Open the output file, or standard output if the file name is empty.
+// Print a message and return NULL on error.
+static FILE* open_output(const std::string& output_file, bool binary)
+{
+    FILE* f = stdout;
+    if (output_file.empty()) {
+#ifdef _WIN32
+        if (binary)
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    } else {
+        f = fopen(output_file.c_str(), binary ? "wb" : "w");
+        if (!f)
+            fprintf(stderr, "Cannot open %s.\n", output_file.c_str());
+    }
+    return f;
+}
+
+// Close the output file, or flush standard output. Return false on error.
+static bool close_output(FILE* f)
+{
+    return (f == stdout ? fflush(f) : fclose(f)) == 0;
+}
+
+bool parameters::run(int* clipped, const settings& s) const
+{
+    // Raw float output is computed directly as float, all other formats
+    // use 8 bit sRGB values.
+    std::vector<unsigned char> colormap(format == raw_rgbf32 ? 0 : 3 * n);
+    std::vector<float> colormap_float(format == raw_rgbf32 ? 3 * n : 0);
+    void* data = (format == raw_rgbf32 ? static_cast<void*>(colormap_float.data()) : colormap.data());
+    size_t size = (format == raw_rgbf32 ? colormap_float.size() * sizeof(float) : colormap.size());
+    std::string description;
+    if (!s.cache_dir.empty())
+        description = cache_description(s);
+    if (s.cache_dir.empty() || !ColorMap::CacheLoad(s.cache_dir, description, data, size, clipped)) {
+        *clipped = generate(format == raw_rgbf32
+                ? ColorMap::Output(ColorMap::SRGBFloat, colormap_float.data())
+                : ColorMap::Output(colormap.data()));
+        if (!s.cache_dir.empty() && !ColorMap::CacheStore(s.cache_dir, description, data, size, *clipped))
+            fprintf(stderr, "Cannot write to cache %s.\n", s.cache_dir.c_str());
+    }
+
+    bool binary = (format != csv && format != json && format != ppm
+            && format != glsl && format != hlsl && format != wgsl);
+    FILE* f = open_output(output_file, binary);
+    if (!f)
+        return false;
+    bool ok;
+    bool reported = false;
+    if (!apply_file.empty()) {
+        ok = apply(colormap.data(), f);
+        reported = true;
+    } else if (format == csv) {
+        ok = ColorMap::WriteCSV(f, n, colormap.data());
     } else if (format == json) {
-        output = ColorMap::ToJSON(n, colormap.data());
+        ok = ColorMap::WriteJSON(f, n, colormap.data());
+    } else if (format == ppm) {
+        ok = ColorMap::WritePPM(f, n, colormap.data());
+    } else if (format == ppm_binary) {
+        ok = ColorMap::WritePPMBinary(f, n, colormap.data());
+    } else if (format == png) {
+        ok = ColorMap::WritePNG(f, n, colormap.data());
+    } else if (format == raw_rgb8) {
+        ok = (fwrite(colormap.data(), 3, n, f) == size_t(n));
+    } else if (format == glsl || format == hlsl || format == wgsl) {
+        std::string shader = ColorMap::ToShader(n, colormap.data(),
+                format == glsl ? ColorMap::GLSL : format == hlsl ? ColorMap::HLSL : ColorMap::WGSL,
+                max_delta_e);
+        ok = (fwrite(shader.data(), 1, shader.size(), f) == shader.size());
+    } else if (format == raw_rgba8) {
+        ok = ColorMap::WriteRGBA8(f, n, colormap.data());
+    } else if (format == raw_rgb565) {
+        ok = ColorMap::WriteRGB565(f, n, colormap.data());
+        std::vector<unsigned short> packed(n);
+        ColorMap::PackRGB565(n, colormap.data(), packed.data());
+        std::sort(packed.begin(), packed.end());
+        int distinct = std::unique(packed.begin(), packed.end()) - packed.begin();
+        if (distinct < n)
+            fprintf(stderr, "%d color(s) are not distinct in RGB565\n", n - distinct);
+    } else if (format == ktx2) {
+        ok = ColorMap::WriteKTX2(f, n, colormap.data());
+    } else if (format == dds) {
+        ok = ColorMap::WriteDDS(f, n, colormap.data());
     } else {
-        output = ColorMap::ToPPM(n, colormap.data());
+        ok = (fwrite(colormap_float.data(), 3 * sizeof(float), n, f) == size_t(n));
+    }
+    bool closed = close_output(f);
+    if (!reported && !(ok && closed)) {
+        fprintf(stderr, "Cannot write %s.\n", output_file.empty() ? "output" : output_file.c_str());
+    } else if (reported && ok && !closed) {
+        fprintf(stderr, "Cannot write output.\n");
+    }
+    if (ok && closed && print_metrics)
+        return metrics();
+    return ok && closed;
+}
+
+// Read a batch file. Each line contains the options for one color map,
+// separated by white space. Empty lines and lines starting with # are ignored.
+static bool read_batch_file(const std::string& batch_file, char* argv0, std::vector<parameters>& jobs)
+{
+    FILE* f = (batch_file == "-" ? stdin : fopen(batch_file.c_str(), "r"));
+    if (!f) {
+        fprintf(stderr, "Cannot open %s.\n", batch_file.c_str());
+        return false;
+    }
+    bool ok = true;
+    int line_number = 0;
+    std::string line;
+    // The jobs run concurrently, so no two of them may write the same file
+    std::map<std::string, int> output_lines;
+    for (;;) {
+        int c = fgetc(f);
+        if (c != EOF && c != '\n') {
+            line.push_back(c);
+            continue;
+        }
+        if (c == EOF && line.empty())
+            break;
+        line_number++;
+        std::vector<std::string> words;
+        for (size_t i = 0; i < line.size();) {
+            if (std::isspace(static_cast<unsigned char>(line[i]))) {
+                i++;
+            } else {
+                size_t j = i;
+                while (j < line.size() && !std::isspace(static_cast<unsigned char>(line[j])))
+                    j++;
+                words.push_back(line.substr(i, j - i));
+                i = j;
+            }
+        }
+        line.clear();
+        if (words.size() > 0 && words[0][0] != '#') {
+            std::vector<char*> args;
+            args.push_back(argv0);
+            for (size_t i = 0; i < words.size(); i++)
+                args.push_back(&(words[i][0]));
+            args.push_back(NULL);
+            parameters p;
+            if (!p.parse(args.size() - 1, args.data(), NULL) || !p.finish()) {
+                fprintf(stderr, "%s:%d: Invalid line.\n", batch_file.c_str(), line_number);
+                ok = false;
+            } else if (p.output_file.empty()) {
+                fprintf(stderr, "%s:%d: Missing option -o|--output.\n", batch_file.c_str(), line_number);
+                ok = false;
+            } else if (output_lines.count(p.output_file) > 0) {
+                fprintf(stderr, "%s:%d: Output %s is already written by line %d.\n", batch_file.c_str(),
+                        line_number, p.output_file.c_str(), output_lines[p.output_file]);
+                ok = false;
+            } else {
+                output_lines[p.output_file] = line_number;
+                jobs.push_back(p);
+            }
+        }
+        if (c == EOF)
+            break;
+    }
+    if (f != stdin)
+        fclose(f);
+    return ok;
+}
+
+static void print_statistics()
+{
+    if (!ColorMap::StatisticsEnabled()) {
+        fprintf(stderr, "Statistics are not available: compiled without COLORMAP_STATISTICS.\n");
+        return;
+    }
+    ColorMap::Statistics st = ColorMap::GetStatistics();
+    fprintf(stderr, "Statistics (times summed over all threads):\n"
+            "  entries time:            %.6f s\n"
+            "    uniform LC solve time: %.6f s\n"
+            "    max. saturation time:  %.6f s\n"
+            "  conversion time:         %.6f s\n"
+            "  color maps:              %lld\n"
+            "  entries:                 %lld\n"
+            "  clipped entries:         %lld\n"
+            "  uniform LC solves:       %lld\n"
+            "  uniform LC fallbacks:    %lld\n"
+            "  LCH distances:           %lld\n"
+            "  max. saturations:        %lld\n"
+            "  most saturated solves:   %lld\n"
+            "  black body integrations: %lld\n"
+            "  transcendental calls:    %lld\n",
+            st.entries_time, st.uniform_lc_time, st.s_max_time, st.conversion_time,
+            st.colormaps, st.entries, st.clipped,
+            st.uniform_lc_solves, st.uniform_lc_fallbacks, st.distance_evaluations,
+            st.s_max_evaluations, st.most_saturated_solves, st.black_body_integrations,
+            st.transcendental_calls);
+}
+
+// Run all jobs, distributed over the given number of threads. Each color map
+// is computed in a single thread.
+static bool run_batch(const std::vector<parameters>& jobs, const settings& s)
+{
+    int threads = s.threads;
+    std::vector<int> clipped(jobs.size());
+    std::vector<unsigned char> ok(jobs.size());
+    std::atomic<size_t> next_job(0);
+    auto worker = [&]() {
+        for (;;) {
+            size_t j = next_job++;
+            if (j >= jobs.size())
+                break;
+            ok[j] = jobs[j].run(&clipped[j], s);
+        }
+    };
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    ColorMap::SetThreads(1);
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; t++)
+        workers.push_back(std::thread(worker));
+    worker();
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+
+    bool all_ok = true;
+    for (size_t j = 0; j < jobs.size(); j++) {
+        if (ok[j])
+            fprintf(stderr, "%s: %d color(s) were clipped\n", jobs[j].output_file.c_str(), clipped[j]);
+        else
+            all_ok = false;
+    }
+    return all_ok;
+}
+
+// Generate one variant of the color map for each combination of the swept
+// parameter values and write them as an atlas with one color map per row.
+// The first swept parameter changes slowest. The variants are distributed
+// over the given number of threads.
+static bool run_sweep(const parameters& base, char* argv0, const settings& s)
+{
+    // The sweepable options and their documented ranges. The values must be
+    // within these ranges: out-of-range values such as negative ones would be
+    // taken as "use the default" by parameters::finish().
+    static const struct {
+        const char* name;
+        float min, max;
+        bool min_exclusive;
+        const char* range;
+    } sweepable[] = {
+        { "hue",               0.0f,      360.0f,   false, "[0,360]" },
+        { "divergence",        0.0f,      360.0f,   false, "[0,360]" },
+        { "contrast",          0.0f,      1.0f,     false, "[0,1]" },
+        { "saturation",        0.0f,      1.0f,     false, "[0,1]" },
+        { "saturation-range",  0.7f,      1.0f,     false, "[0.7,1]" },
+        { "brightness",        0.0f,      1.0f,     false, "[0,1]" },
+        { "warmth",            0.0f,      1.0f,     false, "[0,1]" },
+        { "lightness",         0.0f,      1.0f,     false, "[0,1]" },
+        { "lightness-range",   0.7f,      1.0f,     false, "[0.7,1]" },
+        { "rotations",         -INFINITY, INFINITY, false, "(-infty,infty)" },
+        { "temperature",       0.0f,      INFINITY, false, "[0,infty)" },
+        { "temperature-range", 0.0f,      INFINITY, false, "[0,infty)" },
+        { "gamma",             0.0f,      INFINITY, true,  "(0,infty)" },
+        { "periods",           0.0f,      INFINITY, true,  "(0,infty)" }
+    };
+    class sweep {
+    public:
+        std::string name;
+        float from, to;
+        int count;
+    };
+    std::vector<sweep> sweeps;
+    for (size_t i = 0; i < s.sweeps.size(); i++) {
+        const std::string& arg = s.sweeps[i];
+        size_t comma = arg.find(',');
+        sweep sw;
+        sw.name = arg.substr(0, comma);
+        size_t j = 0;
+        while (j < sizeof(sweepable) / sizeof(sweepable[0]) && sw.name != sweepable[j].name)
+            j++;
+        if (j == sizeof(sweepable) / sizeof(sweepable[0]) || comma == std::string::npos
+                || std::sscanf(arg.c_str() + comma + 1, "%f,%f,%d", &sw.from, &sw.to, &sw.count) != 3
+                || sw.count < 1) {
+            fprintf(stderr, "Invalid argument for option --sweep.\n");
+            return false;
+        }
+        // The values are evenly spaced, so checking the end points suffices
+        float lo = std::min(sw.from, sw.to);
+        float hi = std::max(sw.from, sw.to);
+        if (!std::isfinite(lo) || !std::isfinite(hi)
+                || lo < sweepable[j].min || hi > sweepable[j].max
+                || (sweepable[j].min_exclusive && lo <= sweepable[j].min)) {
+            fprintf(stderr, "Option --sweep requires values in %s for %s.\n",
+                    sweepable[j].range, sw.name.c_str());
+            return false;
+        }
+        sweeps.push_back(sw);
+    }
+    if (sweeps.size() > 2) {
+        fprintf(stderr, "Option --sweep can be given at most twice.\n");
+        return false;
+    }
+    if (!base.apply_file.empty()) {
+        fprintf(stderr, "Options --sweep and -a|--apply cannot be combined.\n");
+        return false;
+    }
+    if (base.format != ppm_binary && base.format != png && base.format != raw_rgb8) {
+        fprintf(stderr, "Option --sweep requires format ppm-binary, png, or raw-rgb8.\n");
+        return false;
+    }
+
+    // Set up all variants first: the options are parsed with getopt, which
+    // cannot be used from several threads
+    int rows = 1;
+    for (size_t i = 0; i < sweeps.size(); i++)
+        rows *= sweeps[i].count;
+    std::vector<parameters> variants(rows, base);
+    for (int row = 0; row < rows; row++) {
+        std::vector<std::string> words;
+        std::string description;
+        int index = row;
+        for (size_t i = sweeps.size(); i-- > 0;) {
+            const sweep& sw = sweeps[i];
+            int k = index % sw.count;
+            index /= sw.count;
+            float value = (sw.count == 1 ? sw.from : sw.from + k * (sw.to - sw.from) / (sw.count - 1));
+            char buf[64];
+            snprintf(buf, sizeof(buf), "--%s=%.9g", sw.name.c_str(), value);
+            words.insert(words.begin(), buf);
+            snprintf(buf, sizeof(buf), " %s=%g", sw.name.c_str(), value);
+            description.insert(0, buf);
+        }
+        std::vector<char*> args;
+        args.push_back(argv0);
+        for (size_t i = 0; i < words.size(); i++)
+            args.push_back(&(words[i][0]));
+        args.push_back(NULL);
+        if (!variants[row].parse(args.size() - 1, args.data(), NULL) || !variants[row].finish())
+            return false;
+        fprintf(stderr, "row %d:%s\n", row, description.c_str());
+    }
+
+    int n = variants[0].n;
+    std::vector<unsigned char> atlas(3 * size_t(n) * rows);
+    std::vector<int> clipped(rows);
+    std::atomic<int> next_row(0);
+    auto worker = [&]() {
+        for (;;) {
+            int row = next_row++;
+            if (row >= rows)
+                break;
+            clipped[row] = variants[row].generate(ColorMap::Output(atlas.data() + 3 * size_t(n) * row));
+        }
+    };
+    int threads = s.threads;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    ColorMap::SetThreads(1);
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; t++)
+        workers.push_back(std::thread(worker));
+    worker();
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+
+    FILE* f = open_output(base.output_file, true);
+    if (!f)
+        return false;
+    bool ok;
+    if (base.format == ppm_binary)
+        ok = ColorMap::WritePPMBinary(f, n, rows, atlas.data());
+    else if (base.format == png)
+        ok = ColorMap::WritePNG(f, n, rows, atlas.data());
+    else
+        ok = (fwrite(atlas.data(), 3 * size_t(n), rows, f) == size_t(rows));
+    if (!close_output(f) || !ok) {
+        fprintf(stderr, "Cannot write %s.\n", base.output_file.empty() ? "output" : base.output_file.c_str());
+        return false;
+    }
+    int total_clipped = 0;
+    for (int row = 0; row < rows; row++)
+        total_clipped += clipped[row];
+    fprintf(stderr, "%d color(s) were clipped\n", total_clipped);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    settings s;
+    parameters p;
+    if (!p.parse(argc, argv, &s))
+        return 1;
+
+    if (s.print_version) {
+        printf("gencolormap version " GENCOLORMAP_VERSION "\n"
+                "https://marlam.de/gencolormap\n"
+                "Copyright (C) 2024 Computer Graphics Group, University of Siegen.\n"
+                "Written by Martin Lambers <martin.lambers@uni-siegen.de>.\n"
+                "This is free software under the terms of the MIT/Expat License.\n"
+                "There is NO WARRANTY, to the extent permitted by law.\n");
+        return 0;
     }
-    fputs(output.c_str(), stdout);
+
+    if (s.print_help) {
+        printf("Usage: %s [option...]\n"
+                "Generates a color map and prints it to standard output.\n"
+                "Prints the number of colors that had to be clipped to standard error.\n"
+                "Common options:\n"
+                "  [-f|--format=csv|json|ppm]          Set output format\n"
+                "  [-f|--format=ppm-binary|png]        Set binary image output format\n"
+                "  [-f|--format=raw-rgb8|raw-rgbf32]   Set raw output format without header\n"
+                "  [-f|--format=glsl|hlsl|wgsl]        Set shader function output format\n"
+                "  [-f|--format=ktx2|dds]              Set 1D texture output format\n"
+                "  [-f|--format=raw-rgba8|raw-rgb565]  Set packed palette output format\n"
+                "  [--max-delta-e=E]                   Set max. CIEDE2000 error of shader output\n"
+                "  [-n|--n=N]                          Set number of colors in the map\n"
+                "  [-F|--fast]                         Use lookup tables instead of exact values\n"
+                "  [-j|--threads=J]                    Set number of threads, 0 for all cores\n"
+                "  [-C|--cache=DIR]                    Reuse color maps stored in directory DIR\n"
+                "  [-o|--output=FILE]                  Write to FILE instead of standard output\n"
+                "  [-B|--batch=FILE]                   Generate the color maps listed in FILE\n"
+                "  [--stats]                           Print timing and operation counts\n"
+                "  [--metrics[=FILE]]                  Print Delta E steps, write each to CSV FILE\n"
+                "  [--sweep=NAME,FROM,TO,COUNT]        Generate an atlas of variants, see below\n"
+                "Applying the color map to data:\n"
+                "  [-a|--apply=FILE]                   Read raw data values from FILE or - for stdin\n"
+                "  [-i|--input-type=float32|uint16]    Set the type of the data values\n"
+                "  [-m|--range=MIN,MAX]                Set the data range mapped to the color map\n"
+                "  [-D|--dimensions=WxH]               Set the data dimensions (required for P6)\n"
+                "  [-N|--nan-color=sr,sg,sb]           Set the color for NaN as sRGB in [0,255]\n"
+                "Brewer-like color maps:\n"
+                "  [-t|--type=brewer-sequential]       Generate a sequential color map\n"
+                "  [-t|--type=brewer-diverging]        Generate a diverging color map\n"
+                "  [-t|--type=brewer-qualitative]      Generate a qualitative color map\n"
+                "  [-h|--hue=H]                        Set default hue in [0,360] degrees\n"
+                "  [-c|--contrast=C]                   Set contrast in [0,1]\n"
+                "  [-s|--saturation=S]                 Set saturation in [0,1]\n"
+                "  [-b|--brightness=B]                 Set brightness in [0,1]\n"
+                "  [-w|--warmth=W]                     Set warmth in [0,1] for seq. and div. maps\n"
+                "  [-d|--divergence=D]                 Set diverg. in deg for div. and qual. maps\n"
+                "  [--stable-order]                    Keep the first colors of qual. maps for all n\n"
+                "Perceptually uniform color maps:\n"
+                "  [-t|--type=pusequential-lightness]  Sequential map, varying lightness\n"
+                "  [-t|--type=pusequential-saturation] Sequential map, varying saturation\n"
+                "  [-t|--type=pusequential-rainbow]    Sequential map, varying hue (rainbow)\n"
+                "  [-t|--type=pusequential-blackbody]  Sequential map, varying hue (black body)\n"
+                "  [-t|--type=pusequential-multihue]   Sequential map, varying hue (custom)\n"
+                "  [-t|--type=pudiverging-lightness]   Diverging map, varying lightness\n"
+                "  [-t|--type=pudiverging-saturation]  Diverging map, varying saturation\n"
+                "  [-t|--type=puqualitative-hue]       Qualitative map, evenly distributed hue\n"
+                "  [-l|--lightness=L]                  Set lightness in [0,1]\n"
+                "  [-L|--lightness-range=LR]           Set lightness range in [0.7,1]\n"
+                "  [-s|--saturation=S]                 Set saturation in [0,1]\n"
+                "  [-S|--saturation-range=SR]          Set saturation range in [0.7,1]\n"
+                "  [-h|--hue=H]                        Set default hue in [0,360] degrees\n"
+                "  [-d|--divergence=D]                 Set diverg. in deg for div. and qual. maps\n"
+                "  [--stable-order]                    Keep the first colors of qual. maps for all n\n"
+                "  [-r|--rotations=R]                  Set number of rotations for rainbow maps\n"
+                "  [-T|--temperature=T]                Set start temp. in K for black body maps\n"
+                "  [-R|--temperature-range=TR]         Set range for temperature in K\n"
+                "  [-V|--hue-values=H0,H1,...]         Set hue values in [0,360] for multi-hue maps\n"
+                "  [-P|--hue-positions=P0,P1,...]      Set hue positions in [0,1] for multi-hue maps\n"
+                "CubeHelix color maps:\n"
+                "  [-t|--type=cubehelix]               Generate a CubeHelix color map\n"
+                "  [-h|--hue=H]                        Set start hue in [0,180] degrees\n"
+                "  [-r|--rotations=R]                  Set number of rotations, in (-infty,infty)\n"
+                "  [-s|--saturation=S]                 Set saturation, in [0,1]\n"
+                "  [-g|--gamma=G]                      Set gamma correction, in (0,infty)\n"
+                "Moreland diverging color maps:\n"
+                "  [-t|--type=moreland]                Generate a Moreland diverging color map\n"
+                "  [-A|--color0=sr,sg,sb]              Set the first color as sRGB in [0,255]\n"
+                "  [-O|--color1=sr,sg,sb]              Set the last color as sRGB in [0,255]\n"
+                "McNames sequential color maps:\n"
+                "  [-t|--type=mcnames]                 Generate a McNames sequential color map\n"
+                "  [-p|--periods=P]                    Set the number of periods in (0, infty)\n"
+                "Defaults: format=csv, n=256, type=brewer-sequential\n"
+                "Batch mode: each line of FILE (or of standard input if FILE is -)\n"
+                "contains the options for one color map, including -o. The threads\n"
+                "process several lines in parallel. Lines starting with # are ignored.\n"
+                "Options for a single color map cannot be given on the command line,\n"
+                "and no two lines may write the same output file.\n"
+                "Apply mode: the color map is applied to the data values, and the colors\n"
+                "are written with format ppm-binary or raw-rgb8. The data is processed in\n"
+                "chunks, so its size is not limited by memory. With dimensions, the data\n"
+                "must contain exactly WxH values. Defaults: input-type=float32, range=0,1\n"
+                "for float32 and 0,65535 for uint16.\n"
+                "Sweep mode: the parameter NAME (the long option name, e.g. hue) takes\n"
+                "COUNT values evenly spaced from FROM to TO, in the units and within the\n"
+                "range of its option. With two --sweep options, all combinations are generated.\n"
+                "The variants are computed in parallel and written as one image with one\n"
+                "color map per row, with format ppm-binary, png, or raw-rgb8.\n"
+                "Shader output: a function colormap(t) that evaluates cubic polynomials\n"
+                "instead of fetching from a texture. Default: max-delta-e=1.\n"
+                "https://marlam.de/gencolormap\n", argv[0]);
+        return 0;
+    }
+
+    if (s.threads < 0) {
+        fprintf(stderr, "Invalid argument for option -j|--threads.\n");
+        return 1;
+    }
+    ColorMap::UseMostSaturatedTable(s.fast);
+    ColorMap::UseBlackBodyTable(s.fast);
+
+    if (!s.batch_file.empty()) {
+        // The options for the color maps are given in the batch file only
+        if (s.have_map_options) {
+            fprintf(stderr, "Option -B|--batch cannot be combined with options for a single color map.\n");
+            return 1;
+        }
+        if (!s.sweeps.empty()) {
+            fprintf(stderr, "Options -B|--batch and --sweep cannot be combined.\n");
+            return 1;
+        }
+        std::vector<parameters> jobs;
+        if (!read_batch_file(s.batch_file, argv[0], jobs))
+            return 1;
+        ColorMap::ResetStatistics();
+        bool ok = run_batch(jobs, s);
+        if (s.print_stats)
+            print_statistics();
+        return ok ? 0 : 1;
+    }
+
+    if (!s.sweeps.empty()) {
+        ColorMap::ResetStatistics();
+        bool ok = run_sweep(p, argv[0], s);
+        if (s.print_stats)
+            print_statistics();
+        return ok ? 0 : 1;
+    }
+
+    if (!p.finish())
+        return 1;
+    ColorMap::SetThreads(s.threads);
+    int clipped;
+    ColorMap::ResetStatistics();
+    if (!p.run(&clipped, s))
+        return 1;
     fprintf(stderr, "%d color(s) were clipped\n", clipped);
+    if (s.print_stats)
+        print_statistics();
 
     return 0;
 }
@@ -24,10 +24,16 @@
 
 #include <algorithm>
 #include <vector>
+#include <memory>
 #include <limits>
 #include <cmath>
 #include <cstring>
 #include <cstdio>
+#include <thread>
+#ifdef COLORMAP_STATISTICS
+# include <atomic>
+# include <chrono>
+#endif
 
 #include "colormap.hpp"
 
@@ -78,6 +84,192 @@ static unsigned char float_to_uchar(float x, bool* clipped = NULL)
     return v < 0 ? 0 : v > 255 ? 255 : v;
 }
 
+static unsigned short float_to_ushort(float x)
+{
+    int v = std::round(x * 65535.0f);
+    return v < 0 ? 0 : v > 65535 ? 65535 : v;
+}
+
+// Convert x in [0,1] to a half float, rounding to nearest even
+static unsigned short float_to_half(float x)
+{
+    unsigned int f;
+    std::memcpy(&f, &x, sizeof(f));
+    if (f < 0x38800000u) {
+        // Denormalized half float, or zero; note that the scaling is exact
+        return std::lrint(x * 16777216.0f);
+    }
+    unsigned int h = (f - 0x38000000u) >> 13;
+    unsigned int rest = f & 0x1fffu;
+    if (rest > 0x1000u || (rest == 0x1000u && (h & 1u)))
+        h++;
+    return h;
+}
+
+/* Parallel computation of color map entries */
+
+static int threads = 1;
+
+void SetThreads(int t)
+{
+    threads = std::max(t, 0);
+}
+
+// Each thread computes at least this many entries; smaller color maps are
+// not worth the thread startup costs.
+static const int min_entries_per_thread = 1024;
+
+// Return the number of threads to use for n items if each thread should
+// process at least min_per_thread items.
+static int thread_count(long long n, long long min_per_thread)
+{
+    long long t = threads;
+    if (t == 0)
+        t = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    return std::min(t, n / min_per_thread);
+}
+
+// Split [0,n) into t consecutive ranges and call f(j, begin, end) for each
+// range j in its own thread.
+template<typename I, typename F>
+static void run_ranges(I n, int t, F f)
+{
+    auto range_begin = [=](int j) { return static_cast<I>(static_cast<unsigned long long>(j) * n / t); };
+    std::vector<std::thread> workers;
+    for (int j = 1; j < t; j++) {
+        workers.emplace_back([&, j]() {
+                f(j, range_begin(j), range_begin(j + 1));
+                });
+    }
+    f(0, 0, range_begin(1));
+    for (auto& w : workers)
+        w.join();
+}
+
+// Call f(begin, end) for consecutive ranges of indices that together cover
+// [0,n), in parallel if enabled. The return values of f are the numbers of
+// clipped colors in each range; their sum is returned.
+template<typename F>
+static int parallel_for(int n, F f)
+{
+    int t = thread_count(n, min_entries_per_thread);
+    if (t <= 1)
+        return f(0, n);
+
+    std::vector<int> clipped(t);
+    run_ranges(n, t, [&](int j, int begin, int end) {
+            clipped[j] = f(begin, end);
+            });
+    int sum = 0;
+    for (int j = 0; j < t; j++)
+        sum += clipped[j];
+    return sum;
+}
+
+/* Statistics */
+
+#ifdef COLORMAP_STATISTICS
+
+enum stats_stage {
+    stage_entries,
+    stage_uniform_lc,
+    stage_s_max,
+    stage_conversion,
+    stage_count
+};
+
+enum stats_counter {
+    counter_colormaps,
+    counter_entries,
+    counter_clipped,
+    counter_uniform_lc_solves,
+    counter_uniform_lc_fallbacks,
+    counter_distance_evaluations,
+    counter_s_max_evaluations,
+    counter_most_saturated_solves,
+    counter_black_body_integrations,
+    counter_transcendental_calls,
+    counter_count
+};
+
+static std::atomic<long long> stats_times[stage_count]; // in nanoseconds
+static std::atomic<long long> stats_counters[counter_count];
+
+// Adds the lifetime of the object to the time of a stage
+class stats_timer {
+private:
+    stats_stage _stage;
+    std::chrono::steady_clock::time_point _start;
+
+public:
+    stats_timer(stats_stage stage) : _stage(stage), _start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~stats_timer()
+    {
+        std::chrono::nanoseconds d = std::chrono::steady_clock::now() - _start;
+        stats_times[_stage].fetch_add(d.count(), std::memory_order_relaxed);
+    }
+};
+
+# define STATS_TIME(stage) stats_timer stats_timer_##stage(stage)
+# define STATS_ADD(counter, value) stats_counters[counter].fetch_add(value, std::memory_order_relaxed)
+
+bool StatisticsEnabled()
+{
+    return true;
+}
+
+void ResetStatistics()
+{
+    for (int i = 0; i < stage_count; i++)
+        stats_times[i] = 0;
+    for (int i = 0; i < counter_count; i++)
+        stats_counters[i] = 0;
+}
+
+Statistics GetStatistics()
+{
+    Statistics s;
+    s.entries_time = stats_times[stage_entries] * 1e-9;
+    s.uniform_lc_time = stats_times[stage_uniform_lc] * 1e-9;
+    s.s_max_time = stats_times[stage_s_max] * 1e-9;
+    s.conversion_time = stats_times[stage_conversion] * 1e-9;
+    s.colormaps = stats_counters[counter_colormaps];
+    s.entries = stats_counters[counter_entries];
+    s.clipped = stats_counters[counter_clipped];
+    s.uniform_lc_solves = stats_counters[counter_uniform_lc_solves];
+    s.uniform_lc_fallbacks = stats_counters[counter_uniform_lc_fallbacks];
+    s.distance_evaluations = stats_counters[counter_distance_evaluations];
+    s.s_max_evaluations = stats_counters[counter_s_max_evaluations];
+    s.most_saturated_solves = stats_counters[counter_most_saturated_solves];
+    s.black_body_integrations = stats_counters[counter_black_body_integrations];
+    s.transcendental_calls = stats_counters[counter_transcendental_calls];
+    return s;
+}
+
+#else
+
+# define STATS_TIME(stage)
+# define STATS_ADD(counter, value)
+
+bool StatisticsEnabled()
+{
+    return false;
+}
+
+void ResetStatistics()
+{
+}
+
+Statistics GetStatistics()
+{
+    return Statistics();
+}
+
+#endif
+
 /* A color triplet class without assumptions about the color space */
 
 class triplet {
@@ -158,6 +350,8 @@ static float lch_chroma(float l, float s)
 
 static float lch_distance(triplet lch0, triplet lch1)
 {
+    STATS_ADD(counter_distance_evaluations, 1);
+    STATS_ADD(counter_transcendental_calls, 1);
     /* We have to compute the euclidean distance in LUV space so that it is
      * perceptually uniform. But using the equations above we can simplify
      * the resulting expression to this: */
@@ -169,21 +363,19 @@ static float lch_distance(triplet lch0, triplet lch1)
 
 static triplet luv_to_xyz(triplet luv)
 {
-    if (luv.l <= 0.0f)
-        return triplet(0.0f, 0.0f, 0.0f);
-
+    // This is written without branches so that loops over it can be
+    // vectorized; see the block conversion functions below.
     triplet xyz;
     float u_prime = luv.u / (13.0f * luv.l) + d65_u_prime;
     float v_prime = luv.v / (13.0f * luv.l) + d65_v_prime;
-    if (luv.l <= 8.0f) {
-        xyz.y = d65_xyz.y * luv.l * (3.0f * 3.0f * 3.0f / (29.0f * 29.0f * 29.0f));
-    } else {
-        float tmp = (luv.l + 16.0f) / 116.0f;
-        xyz.y = d65_xyz.y * tmp * tmp * tmp;
-    }
+    float tmp = (luv.l + 16.0f) / 116.0f;
+    float y_low = d65_xyz.y * luv.l * (3.0f * 3.0f * 3.0f / (29.0f * 29.0f * 29.0f));
+    float y_high = d65_xyz.y * tmp * tmp * tmp;
+    xyz.y = (luv.l <= 8.0f ? y_low : y_high);
     xyz.x = xyz.y * (9.0f * u_prime) / (4.0f * v_prime);
     xyz.z = xyz.y * (12.0f - 3.0f * u_prime - 20.0f * v_prime) / (4.0f * v_prime);
-    return xyz;
+    bool black = (luv.l <= 0.0f);
+    return triplet(black ? 0.0f : xyz.x, black ? 0.0f : xyz.y, black ? 0.0f : xyz.z);
 }
 
 static triplet xyz_to_luv(triplet xyz)
@@ -280,31 +472,316 @@ static triplet srgb_to_rgb(triplet srgb)
     return triplet(srgb_to_rgb_helper(srgb.r), srgb_to_rgb_helper(srgb.g), srgb_to_rgb_helper(srgb.b));
 }
 
-/* Helpers for the conversion to colormap entries */
+/* Conversion of color map entries in blocks
+ *
+ * The generators compute the coordinates of their color map entries in
+ * blocks that store each coordinate in a separate array. The conversion to
+ * the final colors in the output format is then done in separate passes over
+ * each block. Each pass is a simple loop without dependencies between
+ * entries, so that the compiler can vectorize it (with GCC and Clang, some of
+ * them only with -fno-trapping-math). Calls of transcendental functions remain
+ * scalar unless the compiler has a vector math library. The results are the
+ * same as for converting each entry individually. */
+
+static const int block_size = 256;
+
+enum color_space {
+    space_srgb,
+    space_lab,
+    space_luv,
+    space_lch
+};
+
+class block {
+public:
+    float x[block_size];
+    float y[block_size];
+    float z[block_size];
+    unsigned char clipped[block_size]; // boolean values, but vectorizable
+};
+
+static triplet get(const block& b, int j)
+{
+    return triplet(b.x[j], b.y[j], b.z[j]);
+}
+
+static void set(block& b, int j, triplet t)
+{
+    b.x[j] = t.x;
+    b.y[j] = t.y;
+    b.z[j] = t.z;
+}
+
+static void lch_to_luv(int count, block& b)
+{
+    STATS_ADD(counter_transcendental_calls, 2 * count);
+    for (int j = 0; j < count; j++)
+        set(b, j, lch_to_luv(get(b, j)));
+}
+
+static void luv_to_xyz(int count, block& b)
+{
+    for (int j = 0; j < count; j++)
+        set(b, j, luv_to_xyz(get(b, j)));
+}
+
+static void lab_to_xyz(int count, block& b)
+{
+    for (int j = 0; j < count; j++)
+        set(b, j, lab_to_xyz(get(b, j)));
+}
+
+static void xyz_to_rgb(int count, block& b)
+{
+    for (int j = 0; j < count; j++)
+        set(b, j, xyz_to_rgb(get(b, j)));
+}
+
+static void rgb_to_srgb(int count, block& b)
+{
+    STATS_ADD(counter_transcendental_calls, 3 * count);
+    for (int j = 0; j < count; j++)
+        set(b, j, rgb_to_srgb(get(b, j)));
+}
+
+static void srgb_to_rgb(int count, block& b)
+{
+    STATS_ADD(counter_transcendental_calls, 3 * count);
+    for (int j = 0; j < count; j++)
+        set(b, j, srgb_to_rgb(get(b, j)));
+}
+
+// Clip the first count entries of the block to [0,1] and mark clipped
+// entries. Return the number of clipped entries.
+static int clip(int count, block& b)
+{
+    for (int j = 0; j < count; j++) {
+        // use | instead of || to avoid branches
+        b.clipped[j] = b.clipped[j]
+            | (b.x[j] < 0.0f) | (b.x[j] > 1.0f)
+            | (b.y[j] < 0.0f) | (b.y[j] > 1.0f)
+            | (b.z[j] < 0.0f) | (b.z[j] > 1.0f);
+    }
+    int clipped = 0;
+    for (int j = 0; j < count; j++)
+        clipped += b.clipped[j];
+    for (int j = 0; j < count; j++) {
+        b.x[j] = clamp(b.x[j], 0.0f, 1.0f);
+        b.y[j] = clamp(b.y[j], 0.0f, 1.0f);
+        b.z[j] = clamp(b.z[j], 0.0f, 1.0f);
+    }
+    return clipped;
+}
+
+static bool is_linear(Format format)
+{
+    return (format == LinearRGB16 || format == LinearRGBHalf || format == LinearRGBFloat);
+}
+
+static int entry_size(Format format)
+{
+    return 3 * (format == SRGB8 ? sizeof(unsigned char)
+            : format == SRGBFloat || format == LinearRGBFloat ? sizeof(float)
+            : sizeof(unsigned short));
+}
+
+static Output offset(Output colormap, int i)
+{
+    return Output(colormap.format, static_cast<char*>(colormap.data) + i * entry_size(colormap.format));
+}
+
+// Store the first count entries of the block, which must be clipped already,
+// in the color map in its output format.
+static void store(int count, const block& b, Output colormap)
+{
+    switch (colormap.format) {
+    case SRGB8:
+        {
+            unsigned char* p = static_cast<unsigned char*>(colormap.data);
+            for (int j = 0; j < count; j++) {
+                p[3 * j + 0] = float_to_uchar(b.x[j]);
+                p[3 * j + 1] = float_to_uchar(b.y[j]);
+                p[3 * j + 2] = float_to_uchar(b.z[j]);
+            }
+        }
+        break;
+    case SRGB16:
+    case LinearRGB16:
+        {
+            unsigned short* p = static_cast<unsigned short*>(colormap.data);
+            for (int j = 0; j < count; j++) {
+                p[3 * j + 0] = float_to_ushort(b.x[j]);
+                p[3 * j + 1] = float_to_ushort(b.y[j]);
+                p[3 * j + 2] = float_to_ushort(b.z[j]);
+            }
+        }
+        break;
+    case SRGBHalf:
+    case LinearRGBHalf:
+        {
+            unsigned short* p = static_cast<unsigned short*>(colormap.data);
+            for (int j = 0; j < count; j++) {
+                p[3 * j + 0] = float_to_half(b.x[j]);
+                p[3 * j + 1] = float_to_half(b.y[j]);
+                p[3 * j + 2] = float_to_half(b.z[j]);
+            }
+        }
+        break;
+    case SRGBFloat:
+    case LinearRGBFloat:
+        {
+            float* p = static_cast<float*>(colormap.data);
+            for (int j = 0; j < count; j++) {
+                p[3 * j + 0] = b.x[j];
+                p[3 * j + 1] = b.y[j];
+                p[3 * j + 2] = b.z[j];
+            }
+        }
+        break;
+    }
+}
+
+// Convert the first count entries of the block from the given color space
+// to sRGB or linear RGB, depending on the output format, and store them in
+// the color map. Return the number of clipped colors.
+static int block_to_colormap(color_space space, int count, block& b, Output colormap)
+{
+    STATS_TIME(stage_conversion);
+    bool linear = is_linear(colormap.format);
+    int clipped;
+    if (space == space_srgb) {
+        clipped = clip(count, b);
+        if (linear)
+            srgb_to_rgb(count, b);
+    } else {
+        switch (space) {
+        case space_lch:
+            lch_to_luv(count, b);
+            // fallthrough
+        case space_luv:
+            luv_to_xyz(count, b);
+            break;
+        case space_lab:
+            lab_to_xyz(count, b);
+            break;
+        case space_srgb:
+            break;
+        }
+        xyz_to_rgb(count, b);
+        if (!linear)
+            rgb_to_srgb(count, b);
+        clipped = clip(count, b);
+    }
+    store(count, b, colormap);
+    STATS_ADD(counter_clipped, clipped);
+    return clipped;
+}
+
+// Compute all n entries of a color map. The function fill(i0, count, b)
+// stores the coordinates of the count entries starting with entry i0 in the
+// given color space in the block, and sets their clipped flags. The entries
+// are computed in blocks, and in parallel if enabled. If clipped_flags is not
+// NULL, the clipped flag of each entry is stored in it. Return the number of
+// clipped colors.
+template<typename F>
+static int compute_colormap(int n, Output colormap, color_space space, F fill,
+        unsigned char* clipped_flags = NULL)
+{
+    STATS_ADD(counter_colormaps, 1);
+    STATS_ADD(counter_entries, n);
+    return parallel_for(n, [&](int begin, int end) {
+        block b;
+        int clipped = 0;
+        for (int i0 = begin; i0 < end; i0 += block_size) {
+            int count = std::min(block_size, end - i0);
+            {
+                STATS_TIME(stage_entries);
+                fill(i0, count, b);
+            }
+            clipped += block_to_colormap(space, count, b, offset(colormap, i0));
+            if (clipped_flags)
+                std::memcpy(clipped_flags + i0, b.clipped, count);
+        }
+        return clipped;
+    });
+}
+
+/* Color map types
+ *
+ * Each color map type is implemented as a class that precomputes everything
+ * that depends only on the parameters in its constructor. Its member function
+ * entry(i, n, &clipped) returns entry i of a color map with n entries in the
+ * color space given by its member space; it may set clipped to true if it had
+ * to clip the color. Its member function eval(t, &clipped) does the same for
+ * position t in [0,1] of a continuous color map. For most types, entry i is
+ * simply the continuous map at t = (i + 0.5) / n.
+ *
+ * Types that can compute many entries faster at once provide overloads of
+ * entries_to_block() and positions_to_block(). */
+
+// Store count entries starting with entry first of a color map with n entries
+// in the block
+template<typename T>
+static void entries_to_block(const T& type, int first, int count, int n, block& b)
+{
+    for (int j = 0; j < count; j++) {
+        bool c = false;
+        set(b, j, type.entry(first + j, n, &c));
+        b.clipped[j] = c;
+    }
+}
+
+// Store the colors of the continuous color map at the count positions in t,
+// which are in [0,1], in the block
+template<typename T>
+static void positions_to_block(const T& type, int count, const float* t, block& b)
+{
+    for (int j = 0; j < count; j++) {
+        bool c = false;
+        set(b, j, type.eval(t[j], &c));
+        b.clipped[j] = c;
+    }
+}
 
-static bool xyz_to_colormap(triplet xyz, unsigned char* colormap)
+// Compute count entries starting with entry first of a color map with n entries,
+// and optionally store their clipped flags. Return the number of clipped colors.
+template<typename T>
+static int compute_entries(const T& type, int n, int first, int count, Output colormap,
+        unsigned char* clipped_flags = NULL)
 {
-    bool clipped[3];
-    triplet srgb = rgb_to_srgb(xyz_to_rgb(xyz));
-    colormap[0] = float_to_uchar(srgb.r, clipped + 0);
-    colormap[1] = float_to_uchar(srgb.g, clipped + 1);
-    colormap[2] = float_to_uchar(srgb.b, clipped + 2);
-    return clipped[0] || clipped[1] || clipped[2];
+    return compute_colormap(count, colormap, T::space, [&](int i0, int m, block& b) {
+        entries_to_block(type, first + i0, m, n, b);
+    }, clipped_flags);
 }
 
-static bool luv_to_colormap(triplet luv, unsigned char* colormap)
+// Mark the entries of a color map with n entries that can differ from the
+// entries of the same map computed by the previous instance of the type.
+// Return false if all entries can differ. This is the default for all types;
+// types that know which entries depend on which parameters provide overloads.
+template<typename T>
+static bool changed_entries(const T&, const T&, int, unsigned char*)
 {
-    return xyz_to_colormap(luv_to_xyz(luv), colormap);
+    return false;
 }
 
-static bool lch_to_colormap(triplet lch, unsigned char* colormap)
+template<typename T>
+static int compute_entries(const T& type, int n, Output colormap)
 {
-    return luv_to_colormap(lch_to_luv(lch), colormap);
+    return compute_entries(type, n, 0, n, colormap);
 }
 
-static bool lab_to_colormap(triplet lab, unsigned char* colormap)
+// Compute the colors of the continuous color map at the count positions in t.
+// Positions outside of [0,1] are clamped, and NaN is treated as 0.
+// Return the number of clipped colors.
+template<typename T>
+static int compute_positions(const T& type, int count, const float* t, Output colormap)
 {
-    return xyz_to_colormap(lab_to_xyz(lab), colormap);
+    return compute_colormap(count, colormap, T::space, [&](int i0, int m, block& b) {
+        float tt[block_size];
+        for (int j = 0; j < m; j++)
+            tt[j] = (t[i0 + j] >= 0.0f ? std::min(t[i0 + j], 1.0f) : 0.0f);
+        positions_to_block(type, m, tt, b);
+    });
 }
 
 /* Various helpers */
@@ -317,8 +794,10 @@ static float srgb_to_lch_hue(triplet srgb)
 // Compute most saturated color that fits into the sRGB
 // cube for the given LCH hue value. This is the core
 // of the Wijffelaars paper.
-static triplet most_saturated_in_srgb(float lch_hue)
+static triplet most_saturated_in_srgb_exact(float lch_hue)
 {
+    STATS_ADD(counter_most_saturated_solves, 1);
+    STATS_ADD(counter_transcendental_calls, 2);
     /* Static values, only computed once */
     static float h[] = {
         srgb_to_lch_hue(triplet(1, 0, 0)),
@@ -381,8 +860,78 @@ static triplet most_saturated_in_srgb(float lch_hue)
     return xyz_to_luv(rgb_to_xyz(srgb_to_rgb(triplet(srgb[0], srgb[1], srgb[2]))));
 }
 
+// Table of most saturated colors. The exact color is a piecewise smooth
+// function of hue, with kinks at the hues of the sRGB primary and secondary
+// colors. We therefore sample each of the six pieces separately, including
+// its end points, and interpolate linearly in LUV between the samples.
+// The maximum deviation from the exact color is about 0.02 (in LUV units
+// where L is in [0,100]), which is far below noticeable differences.
+static const int most_saturated_table_size = 1024; // per piece
+
+class most_saturated_table {
+public:
+    float piece_hue[7]; // start hues of the six pieces, plus wrap-around
+    std::vector<triplet> samples;
+
+    most_saturated_table() : samples(6 * (most_saturated_table_size + 1))
+    {
+        piece_hue[0] = srgb_to_lch_hue(triplet(1, 0, 0));
+        piece_hue[1] = srgb_to_lch_hue(triplet(1, 1, 0));
+        piece_hue[2] = srgb_to_lch_hue(triplet(0, 1, 0));
+        piece_hue[3] = srgb_to_lch_hue(triplet(0, 1, 1));
+        piece_hue[4] = srgb_to_lch_hue(triplet(0, 0, 1));
+        piece_hue[5] = srgb_to_lch_hue(triplet(1, 0, 1));
+        piece_hue[6] = piece_hue[0] + twopi;
+        for (int p = 0; p < 6; p++) {
+            for (int i = 0; i <= most_saturated_table_size; i++) {
+                float alpha = i / static_cast<float>(most_saturated_table_size);
+                float h = (1.0f - alpha) * piece_hue[p] + alpha * piece_hue[p + 1];
+                if (h >= twopi)
+                    h -= twopi;
+                samples[p * (most_saturated_table_size + 1) + i] = most_saturated_in_srgb_exact(h);
+            }
+        }
+    }
+
+    triplet get(float lch_hue) const
+    {
+        float h = std::fmod(lch_hue, twopi);
+        if (h < 0.0f)
+            h += twopi;
+        if (h < piece_hue[0])
+            h += twopi;
+        int p = 0;
+        while (p < 5 && h >= piece_hue[p + 1])
+            p++;
+        float x = (h - piece_hue[p]) / (piece_hue[p + 1] - piece_hue[p]) * most_saturated_table_size;
+        int i = clamp(x, 0.0f, most_saturated_table_size - 1.0f);
+        float alpha = x - i;
+        const triplet* s = samples.data() + p * (most_saturated_table_size + 1);
+        return (1.0f - alpha) * s[i] + alpha * s[i + 1];
+    }
+};
+
+static bool use_most_saturated_table = false;
+
+void UseMostSaturatedTable(bool use)
+{
+    use_most_saturated_table = use;
+}
+
+static triplet most_saturated_in_srgb(float lch_hue)
+{
+    if (use_most_saturated_table) {
+        static const most_saturated_table table;
+        return table.get(lch_hue);
+    } else {
+        return most_saturated_in_srgb_exact(lch_hue);
+    }
+}
+
 static float s_max(float l, float h)
 {
+    STATS_TIME(stage_s_max);
+    STATS_ADD(counter_s_max_evaluations, 1);
     triplet pmid = most_saturated_in_srgb(h);
     triplet pend = triplet(0.0f, 0.0f, 0.0f);
     if (l > pmid.l)
@@ -395,10 +944,8 @@ static float s_max(float l, float h)
 
 static triplet get_bright_point()
 {
-    static triplet pb(-1.0f, -1.0f, -1.0f);
-    if (pb.l < 0.0f) {
-        pb = xyz_to_luv(rgb_to_xyz(triplet(1.0f, 1.0f, 0.0f)));
-    }
+    // Thread-safe one-time initialization
+    static const triplet pb = xyz_to_luv(rgb_to_xyz(triplet(1.0f, 1.0f, 0.0f)));
     return pb;
 }
 
@@ -449,6 +996,48 @@ static triplet get_colormap_entry(float t,
     return (T <= 0.5f ? b(p0, q0, q1, 2.0f * T) : b(q1, q2, p2, 2.0f * (T - 0.5f)));
 }
 
+// Compute get_colormap_entry() for the count positions in t and store the
+// results in the block, starting at index j0. The power function is computed
+// in a separate pass, and everything that depends only on the control points
+// is computed once. The remaining computations are done in a loop without
+// branches that the compiler can vectorize. The results are the same as for
+// get_colormap_entry().
+static void get_colormap_entries(int count, const float* t,
+        triplet p0, triplet p2,
+        triplet q0, triplet q1, triplet q2,
+        float contrast, float brightness,
+        block& b, int j0)
+{
+    float l[block_size];
+    float e0 = (1.0f - contrast) * brightness;
+    for (int j = 0; j < count; j++)
+        l[j] = 125 - 125 * std::pow(0.2f, e0 + t[j] * contrast);
+
+    // The terms of inv_b() for the lightness of the two Bezier curves
+    float s0 = p0.l - q0.l;
+    float r0 = q0.l * q0.l - p0.l * q1.l;
+    float d0 = p0.l - 2.0f * q0.l + q1.l;
+    float s1 = q1.l - q2.l;
+    float r1 = q2.l * q2.l - q1.l * p2.l;
+    float d1 = q1.l - 2.0f * q2.l + p2.l;
+    for (int j = 0; j < count; j++) {
+        bool lower = (l[j] <= q1.l);
+        float s = (lower ? s0 : s1);
+        float r = (lower ? r0 : r1);
+        float d = (lower ? d0 : d1);
+        float T = 0.5f * ((s + std::sqrt(std::max(r + d * l[j], 0.0f))) / d) + (lower ? 0.0f : 0.5f);
+        bool first = (T <= 0.5f);
+        float u = (first ? 2.0f * T : 2.0f * (T - 0.5f));
+        float wa = (1.0f - u) * (1.0f - u);
+        float wb = 2.0f * (1.0f - u) * u;
+        float wc = u * u;
+        b.x[j0 + j] = wa * (first ? p0.x : q1.x) + wb * (first ? q0.x : q2.x) + wc * (first ? q1.x : p2.x);
+        b.y[j0 + j] = wa * (first ? p0.y : q1.y) + wb * (first ? q0.y : q2.y) + wc * (first ? q1.y : p2.y);
+        b.z[j0 + j] = wa * (first ? p0.z : q1.z) + wb * (first ? q0.z : q2.z) + wc * (first ? q1.z : p2.z);
+        b.clipped[j0 + j] = 0;
+    }
+}
+
 /* Brewer-like color maps */
 
 float BrewerSequentialDefaultContrastForSmallN(int n)
@@ -456,116 +1045,226 @@ float BrewerSequentialDefaultContrastForSmallN(int n)
     return std::min(0.88f, 0.34f + 0.06f * n);
 }
 
-int BrewerSequential(int n, unsigned char* colormap, float hue,
-        float contrast, float saturation, float brightness, float warmth)
-{
-    triplet pb, p0, p1, p2, q0, q1, q2;
-    pb = get_bright_point();
-    triplet pb_lch = luv_to_lch(pb);
-    float pbs = lch_saturation(pb_lch.l, pb_lch.c);
-    get_color_points(hue, saturation, warmth, pb, pb_lch.h, pbs, &p0, &p1, &p2, &q0, &q1, &q2);
+class brewer_sequential {
+public:
+    static const color_space space = space_luv;
+    triplet p0, p2, q0, q1, q2;
+    float contrast, brightness;
+
+    brewer_sequential(float hue, float contrast, float saturation, float brightness, float warmth) :
+        contrast(contrast), brightness(brightness)
+    {
+        triplet pb, p1;
+        pb = get_bright_point();
+        triplet pb_lch = luv_to_lch(pb);
+        float pbs = lch_saturation(pb_lch.l, pb_lch.c);
+        get_color_points(hue, saturation, warmth, pb, pb_lch.h, pbs, &p0, &p1, &p2, &q0, &q1, &q2);
+    }
 
-    int clipped = 0;
-    for (int i = 0; i < n; i++) {
-        float t = (i + 0.5f) / n;
+    triplet eval(float t, bool*) const
+    {
         triplet c = get_colormap_entry(t, p0, p2, q0, q1, q2, contrast, brightness);
-        if (luv_to_colormap(c, colormap + 3 * i))
-            clipped++;
+        return c;
     }
-    return clipped;
+
+    triplet entry(int i, int n, bool* clipped) const
+    {
+        return eval((i + 0.5f) / n, clipped);
+    }
+};
+
+static void entries_to_block(const brewer_sequential& type, int first, int count, int n, block& b)
+{
+    float t[block_size];
+    for (int j = 0; j < count; j++)
+        t[j] = (first + j + 0.5f) / n;
+    positions_to_block(type, count, t, b);
 }
 
-float BrewerDivergingDefaultContrastForSmallN(int n)
+static void positions_to_block(const brewer_sequential& type, int count, const float* t, block& b)
 {
-    return std::min(0.88f, 0.34f + 0.06f * n);
+    get_colormap_entries(count, t, type.p0, type.p2, type.q0, type.q1, type.q2, type.contrast, type.brightness, b, 0);
 }
 
-int BrewerDiverging(int n, unsigned char* colormap, float hue, float divergence,
+int BrewerSequential(int n, Output colormap, float hue,
         float contrast, float saturation, float brightness, float warmth)
 {
-    float hue1 = hue + divergence;
-    if (hue1 >= twopi)
-        hue1 -= twopi;
+    return compute_entries(brewer_sequential(hue, contrast, saturation, brightness, warmth), n, colormap);
+}
 
-    triplet pb;
-    triplet p00, p01, p02, q00, q01, q02;
-    triplet p10, p11, p12, q10, q11, q12;
-    pb = get_bright_point();
-    triplet pb_lch = luv_to_lch(pb);
-    float pbs = lch_saturation(pb_lch.l, pb_lch.c);
-    get_color_points(hue,  saturation, warmth, pb, pb_lch.h, pbs, &p00, &p01, &p02, &q00, &q01, &q02);
-    get_color_points(hue1, saturation, warmth, pb, pb_lch.h, pbs, &p10, &p11, &p12, &q10, &q11, &q12);
+float BrewerDivergingDefaultContrastForSmallN(int n)
+{
+    return std::min(0.88f, 0.34f + 0.06f * n);
+}
 
-    int clipped = 0;
-    for (int i = 0; i < n; i++) {
+class brewer_diverging {
+public:
+    static const color_space space = space_luv;
+    triplet pb_lch;
+    triplet p00, p02, q00, q01, q02;
+    triplet p10, p12, q10, q11, q12;
+    float contrast, brightness, warmth;
+
+    brewer_diverging(float hue, float divergence,
+            float contrast, float saturation, float brightness, float warmth) :
+        contrast(contrast), brightness(brightness), warmth(warmth)
+    {
+        float hue1 = hue + divergence;
+        if (hue1 >= twopi)
+            hue1 -= twopi;
+
+        triplet pb, p01, p11;
+        pb = get_bright_point();
+        pb_lch = luv_to_lch(pb);
+        float pbs = lch_saturation(pb_lch.l, pb_lch.c);
+        get_color_points(hue,  saturation, warmth, pb, pb_lch.h, pbs, &p00, &p01, &p02, &q00, &q01, &q02);
+        get_color_points(hue1, saturation, warmth, pb, pb_lch.h, pbs, &p10, &p11, &p12, &q10, &q11, &q12);
+    }
+
+    // compute neutral color in the middle of the map
+    triplet middle(bool discrete) const
+    {
+        triplet c;
+        triplet c0 = get_colormap_entry(1.0f, p00, p02, q00, q01, q02, contrast, brightness);
+        triplet c1 = get_colormap_entry(1.0f, p10, p12, q10, q11, q12, contrast, brightness);
+        if (discrete) {
+            // for discrete color maps, use an extra neutral color
+            float c0s = luv_saturation(c0);
+            float c1s = luv_saturation(c1);
+            float sn = 0.5f * (c0s + c1s) * warmth;
+            c.l = 0.5f * (c0.l + c1.l);
+            float cc = lch_chroma(c.l, std::min(s_max(c.l, pb_lch.h), sn));
+            c = lch_to_luv(triplet(c.l, cc, pb_lch.h));
+        } else {
+            // for continuous color maps, use an average, since the extra neutral color looks bad
+            c = 0.5f * (c0 + c1);
+        }
+        return c;
+    }
+
+    triplet lower_half(float t) const
+    {
+        float tt = 2.0f * t;
+        return get_colormap_entry(tt, p00, p02, q00, q01, q02, contrast, brightness);
+    }
+
+    triplet upper_half(float t) const
+    {
+        float tt = 2.0f * (1.0f - t);
+        return get_colormap_entry(tt, p10, p12, q10, q11, q12, contrast, brightness);
+    }
+
+    triplet eval(float t, bool*) const
+    {
+        return (t < 0.5f ? lower_half(t) : t > 0.5f ? upper_half(t) : middle(false));
+    }
+
+    triplet entry(int i, int n, bool*) const
+    {
         triplet c;
         if (n % 2 == 1 && i == n / 2) {
-            // compute neutral color in the middle of the map
-            triplet c0 = get_colormap_entry(1.0f, p00, p02, q00, q01, q02, contrast, brightness);
-            triplet c1 = get_colormap_entry(1.0f, p10, p12, q10, q11, q12, contrast, brightness);
-            if (n <= 9) {
-                // for discrete color maps, use an extra neutral color
-                float c0s = luv_saturation(c0);
-                float c1s = luv_saturation(c1);
-                float sn = 0.5f * (c0s + c1s) * warmth;
-                c.l = 0.5f * (c0.l + c1.l);
-                float cc = lch_chroma(c.l, std::min(s_max(c.l, pb_lch.h), sn));
-                c = lch_to_luv(triplet(c.l, cc, pb_lch.h));
-            } else {
-                // for continuous color maps, use an average, since the extra neutral color looks bad
-                c = 0.5f * (c0 + c1);
-            }
+            c = middle(n <= 9);
         } else {
             float t = (i + 0.5f) / n;
             if (i < n / 2) {
-                float tt = 2.0f * t;
-                c = get_colormap_entry(tt, p00, p02, q00, q01, q02, contrast, brightness);
+                c = lower_half(t);
             } else {
-                float tt = 2.0f * (1.0f - t);
-                c = get_colormap_entry(tt, p10, p12, q10, q11, q12, contrast, brightness);
+                c = upper_half(t);
             }
         }
-        if (luv_to_colormap(c, colormap + 3 * i))
-            clipped++;
+        return c;
     }
-    return clipped;
+};
+
+// The entries of the lower half, the middle entry (only for odd n), and the
+// entries of the upper half form consecutive ranges; each half uses its own
+// control points for all its entries
+static void entries_to_block(const brewer_diverging& type, int first, int count, int n, block& b)
+{
+    int lower_end = std::min(std::max(n / 2 - first, 0), count);
+    int upper_begin = std::min(std::max(n / 2 + n % 2 - first, 0), count);
+    float t[block_size];
+    for (int j = 0; j < lower_end; j++)
+        t[j] = 2.0f * ((first + j + 0.5f) / n);
+    for (int j = upper_begin; j < count; j++)
+        t[j] = 2.0f * (1.0f - (first + j + 0.5f) / n);
+    get_colormap_entries(lower_end, t,
+            type.p00, type.p02, type.q00, type.q01, type.q02, type.contrast, type.brightness, b, 0);
+    if (lower_end < upper_begin) {
+        set(b, lower_end, type.middle(n <= 9));
+        b.clipped[lower_end] = 0;
+    }
+    get_colormap_entries(count - upper_begin, t + upper_begin,
+            type.p10, type.p12, type.q10, type.q11, type.q12, type.contrast, type.brightness, b, upper_begin);
 }
 
-int BrewerQualitative(int n, unsigned char* colormap, float hue, float divergence,
-        float contrast, float saturation, float brightness)
+int BrewerDiverging(int n, Output colormap, float hue, float divergence,
+        float contrast, float saturation, float brightness, float warmth)
 {
-    // Get all information about yellow
-    static triplet ylch(-1.0f, -1.0f, -1.0f);
-    if (ylch.l < 0.0f) {
-        ylch = luv_to_lch(xyz_to_luv(rgb_to_xyz(triplet(1.0f, 1.0f, 0.0f))));
-    }
+    return compute_entries(brewer_diverging(hue, divergence, contrast, saturation, brightness, warmth), n, colormap);
+}
 
-    // Get saturation of red (maximum possible saturation)
-    static float rs = -1.0f;
-    if (rs < 0.0f) {
-        triplet rluv = xyz_to_luv(rgb_to_xyz(triplet(1.0f, 0.0f, 0.0f)));
-        rs = luv_saturation(rluv);
-    }
+// The position of color i of a qualitative map with stable order: the
+// fractional part of i times the golden ratio conjugate. Each prefix of this
+// sequence spreads its positions evenly over [0,1), so color i does not
+// depend on the number of colors.
+static float stable_order_position(int i)
+{
+    double t = i * 0.618033988749894848;
+    return t - std::floor(t);
+}
 
-    // Derive parameters of the method
-    float eps = hue / twopi;
-    float r = divergence / twopi;
-    float l0 = brightness * ylch.l;
-    float l1 = (1.0f - contrast) * l0;
+class brewer_qualitative {
+public:
+    static const color_space space = space_luv;
+    triplet ylch;
+    float rs;
+    float eps, r, l0, l1;
+    float saturation;
+    bool stable_order;
+
+    brewer_qualitative(float hue, float divergence,
+            float contrast, float saturation, float brightness, bool stable_order) :
+        saturation(saturation), stable_order(stable_order)
+    {
+        // Get all information about yellow. Generators can be created by
+        // several threads at once, so the constants are initialized only
+        // once as function-local statics.
+        static const triplet static_ylch = luv_to_lch(xyz_to_luv(rgb_to_xyz(triplet(1.0f, 1.0f, 0.0f))));
+        ylch = static_ylch;
+
+        // Get saturation of red (maximum possible saturation)
+        static const float static_rs = luv_saturation(xyz_to_luv(rgb_to_xyz(triplet(1.0f, 0.0f, 0.0f))));
+        rs = static_rs;
+
+        // Derive parameters of the method
+        eps = hue / twopi;
+        r = divergence / twopi;
+        l0 = brightness * ylch.l;
+        l1 = (1.0f - contrast) * l0;
+    }
 
-    // Generate colors
-    int clipped = 0;
-    for (int i = 0; i < n; i++) {
-        float t = (i + 0.5f) / n;
+    triplet eval(float t, bool*) const
+    {
         float ch = std::fmod(twopi * (eps + t * r), twopi);
         float alpha = hue_diff(ch, ylch.h) / pi;
         float cl = (1.0f - alpha) * l0 + alpha * l1;
         float cs = std::min(s_max(cl, ch), saturation * rs);
         triplet c = lch_to_luv(triplet(cl, lch_chroma(cl, cs), ch));
-        if (luv_to_colormap(c, colormap + 3 * i))
-            clipped++;
+        return c;
     }
-    return clipped;
+
+    triplet entry(int i, int n, bool* clipped) const
+    {
+        return eval(stable_order ? stable_order_position(i) : (i + 0.5f) / n, clipped);
+    }
+};
+
+int BrewerQualitative(int n, Output colormap, float hue, float divergence,
+        float contrast, float saturation, float brightness, bool stable_order)
+{
+    return compute_entries(brewer_qualitative(hue, divergence, contrast, saturation, brightness,
+                stable_order), n, colormap);
 }
 
 /* Perceptually uniform (PU) */
@@ -575,6 +1274,10 @@ static triplet lch_compute_uniform_lc(float t,
         triplet lch0, triplet lch1, float D,
         float hue)
 {
+    STATS_TIME(stage_uniform_lc);
+    STATS_ADD(counter_uniform_lc_solves, 1);
+    STATS_ADD(counter_transcendental_calls, 2);
+
     // t is in [0,1]; s is in [0,1] but relative to [t0,t1]
     float s = (t - t0) / (t1 - t0);
 
@@ -585,17 +1288,33 @@ static triplet lch_compute_uniform_lc(float t,
     // compute four solutions for lcht.c based on two conditions:
     float lcht_cs[4];
     // 1) the distance between lcht and lch0 is (s * D)
-    float tmp00 = lch0.c * std::cos(lcht.h - lch0.h);
+    float cos0 = std::cos(lcht.h - lch0.h);
+    float tmp00 = lch0.c * cos0;
     float tmp01 = std::max(0.0f, sqr(tmp00) - sqr(lcht.l - lch0.l) - sqr(lch0.c) + sqr(s * D));
     lcht_cs[0] = tmp00 + std::sqrt(tmp01);
     lcht_cs[1] = tmp00 - std::sqrt(tmp01);
     // 2) the distance between lcht and lch1 is ((1-s) * D)
-    float tmp10 = lch1.c * std::cos(lcht.h - lch1.h);
+    float cos1 = std::cos(lcht.h - lch1.h);
+    float tmp10 = lch1.c * cos1;
     float tmp11 = std::max(0.0f, sqr(tmp10) - sqr(lcht.l - lch1.l) - sqr(lch1.c) + sqr((1.0f - s) * D));
     lcht_cs[2] = tmp10 + std::sqrt(tmp11);
     lcht_cs[3] = tmp10 - std::sqrt(tmp11);
 
     // find the best solution
+    // The distances of the candidates to lch0 and lch1 (see lch_distance())
+    // need the same cosines as above, since cos is even, so no further
+    // trigonometric functions are needed. The errors of all four candidates
+    // are computed without branches, and the valid one with the smallest
+    // error is selected.
+    float solution_errors[4];
+    STATS_ADD(counter_distance_evaluations, 8);
+    for (int i = 0; i < 4; i++) {
+        // solution error is sum of the deviations from condition 1 and 2
+        float c = lcht_cs[i];
+        float dist_lch0_lcht = std::sqrt(sqr(lch0.l - lcht.l) + sqr(lch0.c) + sqr(c) - 2.0f * lch0.c * c * cos0);
+        float dist_lch1_lcht = std::sqrt(sqr(lch1.l - lcht.l) + sqr(lch1.c) + sqr(c) - 2.0f * lch1.c * c * cos1);
+        solution_errors[i] = std::abs(dist_lch0_lcht - s * D) + std::abs(dist_lch1_lcht - (1.0f - s) * D);
+    }
     float min_c = std::min(lch0.c, lch1.c);
     float max_c = std::max(lch0.c, lch1.c);
     float min_solution_error = 9999.9f;
@@ -603,20 +1322,14 @@ static triplet lch_compute_uniform_lc(float t,
     for (int i = 0; i < 4; i++) {
         if (lcht_cs[i] < min_c || lcht_cs[i] > max_c) {
             // this solution is invalid
-        } else {
-            // solution error is sum of the deviations from condition 1 and 2
-            float dist_lch0_lcht = lch_distance(lch0, triplet(lcht.l, lcht_cs[i], lcht.h));
-            float dist_lch1_lcht = lch_distance(lch1, triplet(lcht.l, lcht_cs[i], lcht.h));
-            float solution_error = std::abs(dist_lch0_lcht - s * D) + std::abs(dist_lch1_lcht - (1.0f - s) * D);
-            //fprintf(stderr, "t=%g: VALID %i with error %g\n", t, i, solution_error);
-            if (min_solution_error_index == -1 || solution_error < min_solution_error) {
-                min_solution_error = solution_error;
-                min_solution_error_index = i;
-            }
+        } else if (min_solution_error_index == -1 || solution_errors[i] < min_solution_error) {
+            min_solution_error = solution_errors[i];
+            min_solution_error_index = i;
         }
     }
     if (min_solution_error_index == -1) {
         //fprintf(stderr, "TODO: FALLBACK at t=%g\n", t);
+        STATS_ADD(counter_uniform_lc_fallbacks, 1);
         lcht.c = 0.5f * (lch0.c + lch1.c);
     } else {
         lcht.c = lcht_cs[min_solution_error_index];
@@ -625,135 +1338,180 @@ static triplet lch_compute_uniform_lc(float t,
     return lcht;
 }
 
-int PUSequentialLightness(int n, unsigned char* colormap,
-        float lightness_range, float saturation_range, float saturation, float hue)
-{
+class pu_sequential_lightness {
+public:
+    static const color_space space = space_lch;
     triplet lch_00, lch_10, lch_05;
+    float D_00_05, D_05_10;
+    float hue;
+
+    pu_sequential_lightness(float lightness_range, float saturation_range, float saturation, float hue) :
+        hue(hue)
+    {
+        lch_00.l = (1.0f - lightness_range) * 100.0f;
+        lch_00.c = lch_chroma(lch_00.l, 1.0f - saturation_range);
+        lch_00.h = hue;
+        lch_10.l = lightness_range * 100.0f;
+        lch_10.c = lch_chroma(lch_10.l, 1.0f - saturation_range);
+        lch_10.h = hue;
+        lch_05.l = (1.0f - 0.5f) * lch_00.l + 0.5f * lch_10.l;
+        lch_05.c = lch_chroma(lch_05.l, 5.0f * saturation_range * saturation);
+        lch_05.h = hue;
+
+        // the following distances are actually the same since hue is constant:
+        D_00_05 = lch_distance(lch_00, lch_05);
+        D_05_10 = lch_distance(lch_05, lch_10);
+    }
 
-    lch_00.l = (1.0f - lightness_range) * 100.0f;
-    lch_00.c = lch_chroma(lch_00.l, 1.0f - saturation_range);
-    lch_00.h = hue;
-    lch_10.l = lightness_range * 100.0f;
-    lch_10.c = lch_chroma(lch_10.l, 1.0f - saturation_range);
-    lch_10.h = hue;
-    lch_05.l = (1.0f - 0.5f) * lch_00.l + 0.5f * lch_10.l;
-    lch_05.c = lch_chroma(lch_05.l, 5.0f * saturation_range * saturation);
-    lch_05.h = hue;
-
-    // the following distances are actually the same since hue is constant:
-    float D_00_05 = lch_distance(lch_00, lch_05);
-    float D_05_10 = lch_distance(lch_05, lch_10);
-
-    triplet lch;
-    int clipped = 0;
-    for (int i = 0; i < n; i++) {
-        float t = (i + 0.5f) / n;
+    triplet eval(float t, bool* clipped) const
+    {
+        triplet lch;
         if (t <= 0.5f) {
             lch = lch_compute_uniform_lc(t, 0.0f, 0.5f, lch_00, lch_05, D_00_05, hue);
         } else {
             lch = lch_compute_uniform_lc(t, 0.5f, 1.0f, lch_05, lch_10, D_05_10, hue);
         }
-        bool is_clipped = false;
         if (lch.c > 100.0f) {
-            is_clipped = true;
+            *clipped = true;
             lch.c = 100.0f;
         }
-        if (lch_to_colormap(lch, colormap + 3 * i)) {
-            is_clipped = true;
-        }
-        if (is_clipped)
-            clipped++;
+        return lch;
     }
-    return clipped;
-}
 
-int PUSequentialSaturation(int n, unsigned char* colormap,
-        float saturation_range, float lightness, float saturation, float hue)
+    triplet entry(int i, int n, bool* clipped) const
+    {
+        return eval((i + 0.5f) / n, clipped);
+    }
+};
+
+int PUSequentialLightness(int n, Output colormap,
+        float lightness_range, float saturation_range, float saturation, float hue)
 {
-    lightness = std::max(0.01f, lightness * 100.0f);
+    return compute_entries(pu_sequential_lightness(lightness_range, saturation_range, saturation, hue), n, colormap);
+}
 
+class pu_sequential_saturation {
+public:
+    static const color_space space = space_lch;
     triplet lch_00, lch_10;
-    lch_00.l = lightness;
-    lch_00.c = lch_chroma(lch_00.l, 1.0f - saturation_range);
-    lch_00.h = hue;
-    lch_10.l = lightness;
-    lch_10.c = lch_chroma(lch_10.l, saturation_range * 5.0f * saturation);
-    lch_10.h = hue;
-
-    float D_00_10 = lch_distance(lch_00, lch_10);
+    float D_00_10;
+    float hue;
+
+    pu_sequential_saturation(float saturation_range, float lightness, float saturation, float hue) :
+        hue(hue)
+    {
+        lightness = std::max(0.01f, lightness * 100.0f);
+
+        lch_00.l = lightness;
+        lch_00.c = lch_chroma(lch_00.l, 1.0f - saturation_range);
+        lch_00.h = hue;
+        lch_10.l = lightness;
+        lch_10.c = lch_chroma(lch_10.l, saturation_range * 5.0f * saturation);
+        lch_10.h = hue;
+
+        D_00_10 = lch_distance(lch_00, lch_10);
+    }
 
-    triplet lch;
-    int clipped = 0;
-    for (int i = 0; i < n; i++) {
-        float t = (i + 0.5f) / n;
+    triplet eval(float t, bool* clipped) const
+    {
+        triplet lch;
         lch = lch_compute_uniform_lc(t, 0.0f, 1.0f, lch_00, lch_10, D_00_10, hue);
-        bool is_clipped = false;
         if (lch.c > 100.0f) {
-            is_clipped = true;
+            *clipped = true;
             lch.c = 100.0f;
         }
-        if (lch_to_colormap(lch, colormap + 3 * i)) {
-            is_clipped = true;
-        }
-        if (is_clipped)
-            clipped++;
+        return lch;
     }
-    return clipped;
-}
 
-int PUSequentialRainbow(int n, unsigned char* colormap,
-        float lightness_range, float saturation_range,
-        float hue, float rotations, float saturation)
+    triplet entry(int i, int n, bool* clipped) const
+    {
+        return eval((i + 0.5f) / n, clipped);
+    }
+};
+
+int PUSequentialSaturation(int n, Output colormap,
+        float saturation_range, float lightness, float saturation, float hue)
 {
+    return compute_entries(pu_sequential_saturation(saturation_range, lightness, saturation, hue), n, colormap);
+}
+
+class pu_sequential_rainbow {
+public:
+    static const color_space space = space_lch;
     triplet lch_00, lch_10, lch_05;
+    float D_00_05, D_05_10;
+    float hue, rotations;
+
+    pu_sequential_rainbow(float lightness_range, float saturation_range,
+            float hue, float rotations, float saturation) :
+        hue(hue), rotations(rotations)
+    {
+        lch_00.l = (1.0f - lightness_range) * 100.0f;
+        lch_00.c = lch_chroma(lch_00.l, 1.0f - saturation_range);
+        lch_00.h = hue + 0.0f * rotations * twopi;
+        lch_10.l = lightness_range * 100.0f;
+        lch_10.c = lch_chroma(lch_10.l, 1.0f - saturation_range);
+        lch_10.h = hue + 1.0f * rotations * twopi;
+        lch_05.l = 0.5f * (lch_00.l + lch_10.l);
+        lch_05.c = lch_chroma(lch_05.l, saturation_range * saturation);
+        lch_05.h = hue + 0.5f * rotations * twopi;
+
+        // the following are not necessarily equal because hue varies:
+        D_00_05 = lch_distance(lch_00, lch_05);
+        D_05_10 = lch_distance(lch_05, lch_10);
+    }
 
-    lch_00.l = (1.0f - lightness_range) * 100.0f;
-    lch_00.c = lch_chroma(lch_00.l, 1.0f - saturation_range);
-    lch_00.h = hue + 0.0f * rotations * twopi;
-    lch_10.l = lightness_range * 100.0f;
-    lch_10.c = lch_chroma(lch_10.l, 1.0f - saturation_range);
-    lch_10.h = hue + 1.0f * rotations * twopi;
-    lch_05.l = 0.5f * (lch_00.l + lch_10.l);
-    lch_05.c = lch_chroma(lch_05.l, saturation_range * saturation);
-    lch_05.h = hue + 0.5f * rotations * twopi;
-
-    // the following are not necessarily equal because hue varies:
-    float D_00_05 = lch_distance(lch_00, lch_05);
-    float D_05_10 = lch_distance(lch_05, lch_10);
-
-    triplet lch;
-    int clipped = 0;
-    for (int i = 0; i < n; i++) {
-        float t = (i + 0.5f) / n;
+    triplet eval(float t, bool* clipped) const
+    {
+        triplet lch;
         float h = hue + t * rotations * twopi;
         if (t <= 0.5f) {
             lch = lch_compute_uniform_lc(t, 0.0f, 0.5f, lch_00, lch_05, D_00_05, h);
         } else {
             lch = lch_compute_uniform_lc(t, 0.5f, 1.0f, lch_05, lch_10, D_05_10, h);
         }
-        bool is_clipped = false;
         if (lch.c > 100.0f) {
-            is_clipped = true;
+            *clipped = true;
             lch.c = 100.0f;
         }
-        if (lch_to_colormap(lch, colormap + 3 * i)) {
-            is_clipped = true;
-        }
-        if (is_clipped)
-            clipped++;
+        return lch;
     }
-    return clipped;
+
+    triplet entry(int i, int n, bool* clipped) const
+    {
+        return eval((i + 0.5f) / n, clipped);
+    }
+};
+
+int PUSequentialRainbow(int n, Output colormap,
+        float lightness_range, float saturation_range,
+        float hue, float rotations, float saturation)
+{
+    return compute_entries(pu_sequential_rainbow(lightness_range, saturation_range, hue, rotations, saturation), n, colormap);
 }
 
-static float plancks_law(float temperature, float lambda)
+static const float speed_of_light = 299792458.0f;     // in vacuum
+//static const float speed_of_light = 299700000.0f;     // visible light in air
+static const float plancks_constant = 6.626070041e-34f;
+static const float boltzmann_constant = 1.38064853e-23f;
+
+// Planck's law is split into a factor that depends only on the wavelength
+// and the remaining term, so that the factor can be precomputed for the
+// wavelengths that we sample. The result is the same as computing it all
+// at once.
+static float plancks_law_factor(float lambda)
 {
-    const float c = 299792458.0f;     // speed of light in vacuum
-    //const float c = 299700000.0f;     // speed of visible light in air
-    const float h = 6.626070041e-34f; // Planck's constant
-    const float k = 1.38064853e-23f;  // Boltzmann constant
-    return 2.0f * h * c * c * std::pow(lambda, -5.0f)
-        / (std::exp(h * c / (lambda * k * temperature)) - 1.0f);
+    const float c = speed_of_light;
+    const float h = plancks_constant;
+    return 2.0f * h * c * c * std::pow(lambda, -5.0f);
+}
 
+static float plancks_law(float temperature, float lambda, float factor)
+{
+    const float c = speed_of_light;
+    const float h = plancks_constant;
+    const float k = boltzmann_constant;
+    return factor / (std::exp(h * c / (lambda * k * temperature)) - 1.0f);
 }
 
 #if 0
@@ -874,65 +1632,162 @@ static triplet color_matching_function(int lambda /* in nanometers */)
     return xyz;
 }
 
-static float black_body_hue_at_temperature(float t)
+// Wavelength samples for the integration of the black body spectrum, in 5nm
+// steps, with the terms that do not depend on the temperature precomputed.
+// The color matching function is zero outside of [380,780], so these
+// wavelengths do not contribute and we skip them.
+class black_body_spectrum {
+public:
+    static const int stepsize = 5;
+    static const int lambda_min = 380;
+    static const int lambda_max = 780;
+    static const int samples = (lambda_max - lambda_min) / stepsize + 1;
+    float lambda[samples];      // in meters
+    float factor[samples];      // see plancks_law_factor()
+    triplet cmf[samples];       // see color_matching_function()
+
+    black_body_spectrum()
+    {
+        for (int i = 0; i < samples; i++) {
+            int l = lambda_min + i * stepsize;
+            lambda[i] = l * 1e-9f;
+            factor[i] = plancks_law_factor(lambda[i]);
+            cmf[i] = color_matching_function(l);
+        }
+    }
+};
+
+static float black_body_hue_at_temperature_exact(float t)
 {
+    STATS_ADD(counter_black_body_integrations, 1);
+    static const black_body_spectrum spectrum;
     // Integrate radiance over the visible spectrum; according
     // to literature, sampling at 10nm intervals is enough.
     triplet xyz(0, 0, 0);
-    int stepsize = 5;
-    float s = stepsize * 1e-9f; // stepsize in meters
-    for (int lambda = 360; lambda <= 830; lambda += stepsize) {
-        float l = lambda * 1e-9f; // lambda in in meters
-        float radiosity = pi * plancks_law(t, l);
-        //xyz = xyz + s * radiosity * color_matching_function_approx(l);
-        xyz = xyz + s * radiosity * color_matching_function(lambda);
+    float s = spectrum.stepsize * 1e-9f; // stepsize in meters
+    for (int i = 0; i < spectrum.samples; i++) {
+        float radiosity = pi * plancks_law(t, spectrum.lambda[i], spectrum.factor[i]);
+        //xyz = xyz + s * radiosity * color_matching_function_approx(lambda);
+        xyz = xyz + s * radiosity * spectrum.cmf[i];
     }
     triplet lch = luv_to_lch(xyz_to_luv(adjust_y(xyz, 50.0f)));
     return lch.h;
 }
 
-int PUSequentialBlackBody(int n, unsigned char* colormap,
-        float temperature, float temperature_range,
-        float lightness_range, float saturation_range, float saturation)
+// Table of black body hues for temperatures sampled logarithmically in
+// [250,40000], which covers the parameter ranges of the GUI. The hue is
+// stored without wrapping at 2*PI so that it can be interpolated linearly.
+// The maximum deviation from the exact hue is below 1e-4 radians. Other
+// temperatures are computed exactly.
+static const int black_body_table_size = 4096;
+
+class black_body_table {
+public:
+    float log_t0, log_t1;
+    std::vector<float> hues;
+
+    black_body_table() : log_t0(std::log(250.0f)), log_t1(std::log(40000.0f)), hues(black_body_table_size + 1)
+    {
+        for (int i = 0; i <= black_body_table_size; i++) {
+            float alpha = i / static_cast<float>(black_body_table_size);
+            float h = black_body_hue_at_temperature_exact(std::exp((1.0f - alpha) * log_t0 + alpha * log_t1));
+            if (i > 0) {
+                if (h - hues[i - 1] > pi)
+                    h -= twopi;
+                else if (hues[i - 1] - h > pi)
+                    h += twopi;
+            }
+            hues[i] = h;
+        }
+    }
+
+    bool get(float t, float* hue) const
+    {
+        float x = (std::log(t) - log_t0) / (log_t1 - log_t0) * black_body_table_size;
+        if (!(x >= 0.0f && x <= black_body_table_size))
+            return false;
+        int i = std::min(static_cast<int>(x), black_body_table_size - 1);
+        float alpha = x - i;
+        float h = std::fmod((1.0f - alpha) * hues[i] + alpha * hues[i + 1], twopi);
+        if (h < 0.0f)
+            h += twopi;
+        *hue = h;
+        return true;
+    }
+};
+
+static bool use_black_body_table = false;
+
+void UseBlackBodyTable(bool use)
+{
+    use_black_body_table = use;
+}
+
+static float black_body_hue_at_temperature(float t)
 {
+    if (use_black_body_table) {
+        static const black_body_table table;
+        float hue;
+        if (table.get(t, &hue))
+            return hue;
+    }
+    return black_body_hue_at_temperature_exact(t);
+}
+
+class pu_sequential_black_body {
+public:
+    static const color_space space = space_lch;
     triplet lch_00, lch_10, lch_05;
+    float D_00_05, D_05_10;
+    float temperature, temperature_range;
+
+    pu_sequential_black_body(float temperature, float temperature_range,
+            float lightness_range, float saturation_range, float saturation) :
+        temperature(temperature), temperature_range(temperature_range)
+    {
+        lch_00.l = (1.0f - lightness_range) * 100.0f;
+        lch_00.c = lch_chroma(lch_00.l, 1.0f - saturation_range);
+        lch_00.h = black_body_hue_at_temperature(temperature + 0.0f * temperature_range);
+        lch_10.l = lightness_range * 100.0f;
+        lch_10.c = lch_chroma(lch_10.l, 1.0f - saturation_range);
+        lch_10.h = black_body_hue_at_temperature(temperature + 1.0f * temperature_range);
+        lch_05.l = 0.5f * (lch_00.l + lch_10.l);
+        lch_05.c = lch_chroma(lch_05.l, saturation_range * saturation);
+        lch_05.h = black_body_hue_at_temperature(temperature + 0.5f * temperature_range);
+
+        // the following are not necessarily equal because hue varies:
+        D_00_05 = lch_distance(lch_00, lch_05);
+        D_05_10 = lch_distance(lch_05, lch_10);
+    }
 
-    lch_00.l = (1.0f - lightness_range) * 100.0f;
-    lch_00.c = lch_chroma(lch_00.l, 1.0f - saturation_range);
-    lch_00.h = black_body_hue_at_temperature(temperature + 0.0f * temperature_range);
-    lch_10.l = lightness_range * 100.0f;
-    lch_10.c = lch_chroma(lch_10.l, 1.0f - saturation_range);
-    lch_10.h = black_body_hue_at_temperature(temperature + 1.0f * temperature_range);
-    lch_05.l = 0.5f * (lch_00.l + lch_10.l);
-    lch_05.c = lch_chroma(lch_05.l, saturation_range * saturation);
-    lch_05.h = black_body_hue_at_temperature(temperature + 0.5f * temperature_range);
-
-    // the following are not necessarily equal because hue varies:
-    float D_00_05 = lch_distance(lch_00, lch_05);
-    float D_05_10 = lch_distance(lch_05, lch_10);
-
-    triplet lch;
-    int clipped = 0;
-    for (int i = 0; i < n; i++) {
-        float t = (i + 0.5f) / n;
+    triplet eval(float t, bool* clipped) const
+    {
+        triplet lch;
         float h = black_body_hue_at_temperature(temperature + t * temperature_range);
         if (t <= 0.5f) {
             lch = lch_compute_uniform_lc(t, 0.0f, 0.5f, lch_00, lch_05, D_00_05, h);
         } else {
             lch = lch_compute_uniform_lc(t, 0.5f, 1.0f, lch_05, lch_10, D_05_10, h);
         }
-        bool is_clipped = false;
         if (lch.c > 100.0f) {
-            is_clipped = true;
+            *clipped = true;
             lch.c = 100.0f;
         }
-        if (lch_to_colormap(lch, colormap + 3 * i)) {
-            is_clipped = true;
-        }
-        if (is_clipped)
-            clipped++;
+        return lch;
     }
-    return clipped;
+
+    triplet entry(int i, int n, bool* clipped) const
+    {
+        return eval((i + 0.5f) / n, clipped);
+    }
+};
+
+int PUSequentialBlackBody(int n, Output colormap,
+        float temperature, float temperature_range,
+        float lightness_range, float saturation_range, float saturation)
+{
+    return compute_entries(pu_sequential_black_body(temperature, temperature_range,
+                lightness_range, saturation_range, saturation), n, colormap);
 }
 
 static float multi_hue_get(float t, int hues, const float* hue_values, const float* hue_positions)
@@ -946,12 +1801,10 @@ static float multi_hue_get(float t, int hues, const float* hue_values, const flo
         return hue_values[0];
     if (t >= hue_positions[hues - 1])
         return hue_values[hues - 1];
-    /* Find index i so that t is in [hue_positions[i], hue_positions[i+1]]  */
-    int i;
-    for (i = 0; i < hues - 2; i++) {
-        if (t >= hue_positions[i] && t < hue_positions[i+1])
-            break;
-    }
+    /* Find index i so that t is in [hue_positions[i], hue_positions[i+1]];
+     * the positions are sorted, so use binary search */
+    int i = std::upper_bound(hue_positions, hue_positions + hues, t) - hue_positions - 1;
+    i = std::min(i, hues - 2);
     float h0 = hue_values[i];
     float h1 = hue_values[i + 1];
     float p0 = hue_positions[i];
@@ -970,135 +1823,275 @@ static float multi_hue_get(float t, int hues, const float* hue_values, const flo
     return hue;
 }
 
-int PUSequentialMultiHue(int n, unsigned char* colormap,
-        float lightness_range,
-        float saturation_range,
-        float saturation,
-        int hues,
-        const float* hue_values,
-        const float* hue_positions)
-{
+class pu_sequential_multi_hue {
+public:
+    static const color_space space = space_lch;
+    std::vector<float> hue_values;
+    std::vector<float> hue_positions;
     triplet lch_00, lch_10, lch_05;
+    float D_00_05, D_05_10;
+
+    pu_sequential_multi_hue(float lightness_range, float saturation_range, float saturation,
+            int hues, const float* hue_values, const float* hue_positions) :
+        hue_values(hue_values, hue_values + std::max(hues, 0)),
+        hue_positions(hue_positions, hue_positions + std::max(hues, 0))
+    {
+        lch_00.l = (1.0f - lightness_range) * 100.0f;
+        lch_00.c = lch_chroma(lch_00.l, 1.0f - saturation_range);
+        lch_00.h = hue(0.0f);
+        lch_10.l = lightness_range * 100.0f;
+        lch_10.c = lch_chroma(lch_10.l, 1.0f - saturation_range);
+        lch_10.h = hue(1.0f);
+        lch_05.l = (1.0f - 0.5f) * lch_00.l + 0.5f * lch_10.l;
+        lch_05.c = lch_chroma(lch_05.l, 5.0f * saturation_range * saturation);
+        lch_05.h = hue(0.5f);
+
+        // the following distances should ideally be the same,
+        // but they are usually not since we use different hues.
+        // at least they should be close since hue differences
+        // are less dominant in the distance measure.
+        D_00_05 = lch_distance(lch_00, lch_05);
+        D_05_10 = lch_distance(lch_05, lch_10);
+    }
 
-    lch_00.l = (1.0f - lightness_range) * 100.0f;
-    lch_00.c = lch_chroma(lch_00.l, 1.0f - saturation_range);
-    lch_00.h = multi_hue_get(0.0f, hues, hue_values, hue_positions);
-    lch_10.l = lightness_range * 100.0f;
-    lch_10.c = lch_chroma(lch_10.l, 1.0f - saturation_range);
-    lch_10.h = multi_hue_get(1.0f, hues, hue_values, hue_positions);
-    lch_05.l = (1.0f - 0.5f) * lch_00.l + 0.5f * lch_10.l;
-    lch_05.c = lch_chroma(lch_05.l, 5.0f * saturation_range * saturation);
-    lch_05.h = multi_hue_get(0.5f, hues, hue_values, hue_positions);
-
-    // the following distances should ideally be the same,
-    // but they are usually not since we use different hues.
-    // at least they should be close since hue differences
-    // are less dominant in the distance measure.
-    float D_00_05 = lch_distance(lch_00, lch_05);
-    float D_05_10 = lch_distance(lch_05, lch_10);
-
-    triplet lch;
-    int clipped = 0;
-    for (int i = 0; i < n; i++) {
-        float t = (i + 0.5f) / n;
-        float h = multi_hue_get(t, hues, hue_values, hue_positions);
+    float hue(float t) const
+    {
+        return multi_hue_get(t, hue_values.size(), hue_values.data(), hue_positions.data());
+    }
+
+    triplet eval(float t, bool* clipped) const
+    {
+        triplet lch;
+        float h = hue(t);
         if (t <= 0.5f) {
             lch = lch_compute_uniform_lc(t, 0.0f, 0.5f, lch_00, lch_05, D_00_05, h);
         } else {
             lch = lch_compute_uniform_lc(t, 0.5f, 1.0f, lch_05, lch_10, D_05_10, h);
         }
-        bool is_clipped = false;
         if (lch.c > 100.0f) {
-            is_clipped = true;
+            *clipped = true;
             lch.c = 100.0f;
         }
-        if (lch_to_colormap(lch, colormap + 3 * i)) {
-            is_clipped = true;
+        return lch;
+    }
+
+    triplet entry(int i, int n, bool* clipped) const
+    {
+        return eval((i + 0.5f) / n, clipped);
+    }
+};
+
+// Entry i only depends on the three anchor colors, their distances, and the
+// hue at its position, so it is unchanged if these are unchanged. Editing one
+// hue value or position thus only affects the entries in the adjacent segments.
+static bool changed_entries(const pu_sequential_multi_hue& type, const pu_sequential_multi_hue& previous,
+        int n, unsigned char* changed)
+{
+    auto same = [](triplet t0, triplet t1) { return t0.x == t1.x && t0.y == t1.y && t0.z == t1.z; };
+    if (!same(type.lch_00, previous.lch_00) || !same(type.lch_05, previous.lch_05)
+            || !same(type.lch_10, previous.lch_10)
+            || type.D_00_05 != previous.D_00_05 || type.D_05_10 != previous.D_05_10)
+        return false;
+
+    // Compare the hues of all entries whose position may lie in a segment
+    // that differs between the two maps. With the same number of hues, this
+    // is only the case for segments k (between hue k and k+1; -1 and hues-1
+    // are the constant parts before the first and after the last hue) that
+    // have different hue values or positions.
+    int hues = type.hue_values.size();
+    std::fill(changed, changed + n, 0);
+    auto compare = [&](int begin, int end) {
+        for (int i = std::max(begin, 0); i < std::min(end, n); i++) {
+            float t = (i + 0.5f) / n;
+            changed[i] = (type.hue(t) != previous.hue(t));
         }
-        if (is_clipped)
-            clipped++;
+    };
+    if (hues < 2 || previous.hue_values.size() != type.hue_values.size()) {
+        compare(0, n);
+        return true;
     }
-    return clipped;
+    auto same_hue = [&](int k) {
+        return type.hue_values[k] == previous.hue_values[k] && type.hue_positions[k] == previous.hue_positions[k];
+    };
+    for (int k = -1; k < hues; k++) {
+        if ((k < 0 || same_hue(k)) && (k + 1 >= hues || same_hue(k + 1)))
+            continue;
+        float t0 = (k < 0 ? 0.0f : std::min(type.hue_positions[k], previous.hue_positions[k]));
+        float t1 = (k + 1 >= hues ? 1.0f : std::max(type.hue_positions[k + 1], previous.hue_positions[k + 1]));
+        // one extra entry on each side covers rounding errors
+        compare(std::floor(t0 * n - 0.5f) - 1, std::ceil(t1 * n - 0.5f) + 2);
+    }
+    return true;
 }
 
-int PUDivergingLightness(int n, unsigned char* colormap,
-        float lightness_range, float saturation_range, float saturation, float hue, float divergence)
+int PUSequentialMultiHue(int n, Output colormap,
+        float lightness_range,
+        float saturation_range,
+        float saturation,
+        int hues,
+        const float* hue_values,
+        const float* hue_positions)
 {
-    int lowerN = n / 2;
-    int higherN = n - lowerN;
-    int clipped = 0;
+    return compute_entries(pu_sequential_multi_hue(lightness_range, saturation_range, saturation,
+                hues, hue_values, hue_positions), n, colormap);
+}
 
-    clipped += PUSequentialLightness(higherN, colormap, lightness_range, saturation_range, saturation, hue + divergence);
-    for (int i = 0; i < higherN; i++)
-        for (int j = 0; j < 3; j++)
-            colormap[3 * lowerN + 3 * i + j] = colormap[3 * (higherN - 1 - i) + j];
-    clipped += PUSequentialLightness(lowerN, colormap, lightness_range, saturation_range, saturation, hue);
-    return clipped;
+// The diverging maps consist of two sequential maps with n/2 entries each.
+// Note that for odd n, the two halves have different sizes.
+
+class pu_diverging_lightness {
+public:
+    static const color_space space = space_lch;
+    pu_sequential_lightness lower, higher;
+
+    pu_diverging_lightness(float lightness_range, float saturation_range, float saturation,
+            float hue, float divergence) :
+        lower(lightness_range, saturation_range, saturation, hue),
+        higher(lightness_range, saturation_range, saturation, hue + divergence)
+    {
+    }
+
+    triplet entry(int i, int n, bool* clipped) const
+    {
+        int lowerN = n / 2;
+        int higherN = n - lowerN;
+        if (i < lowerN)
+            return lower.entry(i, lowerN, clipped);
+        else
+            return higher.entry(higherN - 1 - (i - lowerN), higherN, clipped);
+    }
+
+    triplet eval(float t, bool* clipped) const
+    {
+        if (t < 0.5f)
+            return lower.eval(2.0f * t, clipped);
+        else
+            return higher.eval(2.0f * (1.0f - t), clipped);
+    }
+};
+
+int PUDivergingLightness(int n, Output colormap,
+        float lightness_range, float saturation_range, float saturation, float hue, float divergence)
+{
+    return compute_entries(pu_diverging_lightness(lightness_range, saturation_range, saturation,
+                hue, divergence), n, colormap);
 }
 
-int PUDivergingSaturation(int n, unsigned char* colormap,
+class pu_diverging_saturation {
+public:
+    static const color_space space = space_lch;
+    pu_sequential_saturation lower, higher;
+
+    pu_diverging_saturation(float saturation_range, float lightness, float saturation,
+            float hue, float divergence) :
+        lower(saturation_range, lightness, saturation, hue),
+        higher(saturation_range, lightness, saturation, hue + divergence)
+    {
+    }
+
+    triplet entry(int i, int n, bool* clipped) const
+    {
+        int lowerN = n / 2;
+        int higherN = n - lowerN;
+        if (i < lowerN)
+            return lower.entry(lowerN - 1 - i, lowerN, clipped);
+        else
+            return higher.entry(i - lowerN, higherN, clipped);
+    }
+
+    triplet eval(float t, bool* clipped) const
+    {
+        if (t < 0.5f)
+            return lower.eval(1.0f - 2.0f * t, clipped);
+        else
+            return higher.eval(2.0f * t - 1.0f, clipped);
+    }
+};
+
+int PUDivergingSaturation(int n, Output colormap,
         float saturation_range, float lightness, float saturation, float hue, float divergence)
 {
-    int lowerN = n / 2;
-    int higherN = n - lowerN;
-    int clipped = 0;
-
-    clipped += PUSequentialSaturation(lowerN, colormap + 3 * lowerN, saturation_range, lightness, saturation, hue);
-    for (int i = 0; i < lowerN; i++)
-        for (int j = 0; j < 3; j++)
-            colormap[3 * i + j] = colormap[3 * lowerN + 3 * (lowerN - 1 - i) + j];
-    clipped += PUSequentialSaturation(higherN, colormap + 3 * lowerN, saturation_range, lightness, saturation, hue + divergence);
-    return clipped;
+    return compute_entries(pu_diverging_saturation(saturation_range, lightness, saturation,
+                hue, divergence), n, colormap);
 }
 
-int PUQualitativeHue(int n, unsigned char* colormap,
-        float hue, float divergence, float lightness, float saturation)
-{
-    divergence *= (n - 1.0f) / n;
-    triplet lch;
-    lch.l = std::max(0.01f, lightness * 100.0f);
-    lch.c = lch_chroma(lch.l, saturation * 5.0f);
-    bool all_clipped = (lch.c > 100.0f);
-    if (all_clipped)
-        lch.c = 100.0f;
-    int clipped = 0;
-    for (int i = 0; i < n; i++) {
+class pu_qualitative_hue {
+public:
+    static const color_space space = space_lch;
+    float hue, divergence, l, c;
+    bool all_clipped;
+    bool stable_order;
+
+    pu_qualitative_hue(float hue, float divergence, float lightness, float saturation, bool stable_order) :
+        hue(hue), divergence(divergence), stable_order(stable_order)
+    {
+        l = std::max(0.01f, lightness * 100.0f);
+        c = lch_chroma(l, saturation * 5.0f);
+        all_clipped = (c > 100.0f);
+        if (all_clipped)
+            c = 100.0f;
+    }
+
+    // The discrete map shrinks the hue range so that the first and the last
+    // color differ for divergence = 2pi; the continuous map does not.
+    triplet eval(float t, bool* clipped) const
+    {
+        *clipped = all_clipped;
+        return triplet(l, c, hue + t * divergence);
+    }
+
+    triplet entry(int i, int n, bool* clipped) const
+    {
+        if (stable_order)
+            return eval(stable_order_position(i), clipped);
+        float d = divergence * ((n - 1.0f) / n);
         float t = (i + 0.5f) / n;
-        lch.h = hue + t * divergence;
-        bool is_clipped = false;
-        if (lch_to_colormap(lch, colormap + 3 * i))
-            is_clipped = true;
-        if (is_clipped || all_clipped)
-            clipped++;
+        *clipped = all_clipped;
+        return triplet(l, c, hue + t * d);
     }
-    return clipped;
+};
+
+int PUQualitativeHue(int n, Output colormap,
+        float hue, float divergence, float lightness, float saturation, bool stable_order)
+{
+    return compute_entries(pu_qualitative_hue(hue, divergence, lightness, saturation, stable_order), n, colormap);
 }
 
 /* CubeHelix */
 
-int CubeHelix(int n, unsigned char* colormap, float hue,
-        float rot, float saturation, float gamma)
-{
-    int clipped = 0;
-    for (int i = 0; i < n; i++) {
-        float fract = (i + 0.5f) / n;
+class cube_helix {
+public:
+    static const color_space space = space_srgb;
+    float hue, rot, saturation, gamma;
+
+    cube_helix(float hue, float rot, float saturation, float gamma) :
+        hue(hue), rot(rot), saturation(saturation), gamma(gamma)
+    {
+    }
+
+    triplet eval(float fract, bool*) const
+    {
         float angle = twopi * (hue / 3.0f + 1.0f + rot * fract);
         fract = std::pow(fract, gamma);
         float amp = saturation * fract * (1.0f - fract) / 2.0f;
         float s = std::sin(angle);
         float c = std::cos(angle);
-        triplet srgb(
+        return triplet(
                 fract + amp * (-0.14861f * c + 1.78277f * s),
                 fract + amp * (-0.29227f * c - 0.90649f * s),
                 fract + amp * (1.97294f * c));
-        bool clipped_[3];
-        colormap[3 * i + 0] = float_to_uchar(srgb.r, clipped_ + 0);
-        colormap[3 * i + 1] = float_to_uchar(srgb.g, clipped_ + 1);
-        colormap[3 * i + 2] = float_to_uchar(srgb.b, clipped_ + 2);
-        if (clipped_[0] || clipped_[1] || clipped_[2])
-            clipped++;
     }
-    return clipped;
+
+    triplet entry(int i, int n, bool* clipped) const
+    {
+        return eval((i + 0.5f) / n, clipped);
+    }
+};
+
+int CubeHelix(int n, Output colormap, float hue,
+        float rot, float saturation, float gamma)
+{
+    return compute_entries(cube_helix(hue, rot, saturation, gamma), n, colormap);
 }
 
 /* Moreland */
@@ -1134,22 +2127,28 @@ static float adjust_hue(triplet msh, float unsaturated_m)
     }
 }
 
-int Moreland(int n, unsigned char* colormap,
-        unsigned char sr0, unsigned char sg0, unsigned char sb0,
-        unsigned char sr1, unsigned char sg1, unsigned char sb1)
-{
-    triplet omsh0 = lab_to_msh(xyz_to_lab(rgb_to_xyz(srgb_to_rgb(triplet(
-                            uchar_to_float(sr0), uchar_to_float(sg0), uchar_to_float(sb0))))));
-    triplet omsh1 = lab_to_msh(xyz_to_lab(rgb_to_xyz(srgb_to_rgb(triplet(
-                            uchar_to_float(sr1), uchar_to_float(sg1), uchar_to_float(sb1))))));
-    bool place_white = (omsh0.s >= 0.05f && omsh1.s >= 0.05f && hue_diff(omsh0.h, omsh1.h) > pi / 3.0f);
-    float mmid = std::max(std::max(omsh0.m, omsh1.m), 88.0f);
+class moreland {
+public:
+    static const color_space space = space_lab;
+    triplet omsh0, omsh1;
+    bool place_white;
+    float mmid;
+
+    moreland(unsigned char sr0, unsigned char sg0, unsigned char sb0,
+            unsigned char sr1, unsigned char sg1, unsigned char sb1)
+    {
+        omsh0 = lab_to_msh(xyz_to_lab(rgb_to_xyz(srgb_to_rgb(triplet(
+                                uchar_to_float(sr0), uchar_to_float(sg0), uchar_to_float(sb0))))));
+        omsh1 = lab_to_msh(xyz_to_lab(rgb_to_xyz(srgb_to_rgb(triplet(
+                                uchar_to_float(sr1), uchar_to_float(sg1), uchar_to_float(sb1))))));
+        place_white = (omsh0.s >= 0.05f && omsh1.s >= 0.05f && hue_diff(omsh0.h, omsh1.h) > pi / 3.0f);
+        mmid = std::max(std::max(omsh0.m, omsh1.m), 88.0f);
+    }
 
-    int clipped = 0;
-    for (int i = 0; i < n; i++) {
+    triplet eval(float t, bool*) const
+    {
         triplet msh0 = omsh0;
         triplet msh1 = omsh1;
-        float t = (i + 0.5f) / n;
         if (place_white) {
             if (t < 0.5f) {
                 msh1.m = mmid;
@@ -1169,10 +2168,20 @@ int Moreland(int n, unsigned char* colormap,
             msh1.h = adjust_hue(msh0, msh1.m);
         }
         triplet msh = (1.0f - t) * msh0 + t * msh1;
-        if (lab_to_colormap(msh_to_lab(msh), colormap + 3 * i))
-            clipped++;
+        return msh_to_lab(msh);
     }
-    return clipped;
+
+    triplet entry(int i, int n, bool* clipped) const
+    {
+        return eval((i + 0.5f) / n, clipped);
+    }
+};
+
+int Moreland(int n, Output colormap,
+        unsigned char sr0, unsigned char sg0, unsigned char sb0,
+        unsigned char sr1, unsigned char sg1, unsigned char sb1)
+{
+    return compute_entries(moreland(sr0, sg0, sb0, sr1, sg1, sb1), n, colormap);
 }
 
 /* McNames */
@@ -1207,15 +2216,22 @@ static float windowfunc(float t)
 #endif
 }
 
-int McNames(int n, unsigned char* colormap, float periods)
-{
-    static const float sqrt3 = std::sqrt(3.0f);
-    static const float a12 = std::asin(1.0f / sqrt3);
-    static const float a23 = pi / 4.0f;
+class mcnames {
+public:
+    static const color_space space = space_srgb;
+    float periods;
 
-    int clipped = 0;
-    for (int i = 0; i < n; i++) {
-        float t = 1.0f - (i + 0.5f) / n;
+    mcnames(float periods) : periods(periods)
+    {
+    }
+
+    triplet eval(float t, bool*) const
+    {
+        static const float sqrt3 = std::sqrt(3.0f);
+        static const float a12 = std::asin(1.0f / sqrt3);
+        static const float a23 = pi / 4.0f;
+
+        t = 1.0f - t;
         float w = windowfunc(t);
         float tt = (1.0f - t) * sqrt3;
         float ttt = (tt - sqrt3 / 2.0f) * periods * twopi / sqrt3;
@@ -1232,14 +2248,436 @@ int McNames(int n, unsigned char* colormap, float periods)
         pol2cart(ag + a23, rd, &r2, &b2);
         g2 = g1;
 
-        bool clipped_[3];
-        colormap[3 * i + 0] = float_to_uchar(r2, clipped_ + 0);
-        colormap[3 * i + 1] = float_to_uchar(g2, clipped_ + 1);
-        colormap[3 * i + 2] = float_to_uchar(b2, clipped_ + 2);
-        if (clipped_[0] || clipped_[1] || clipped_[2])
-            clipped++;
+        return triplet(r2, g2, b2);
     }
-    return clipped;
+
+    triplet entry(int i, int n, bool* clipped) const
+    {
+        return eval((i + 0.5f) / n, clipped);
+    }
+};
+
+int McNames(int n, Output colormap, float periods)
+{
+    return compute_entries(mcnames(periods), n, colormap);
+}
+
+
+/* Generators */
+
+class GeneratorImplementation {
+public:
+    virtual ~GeneratorImplementation() {}
+    virtual int generate(int n, int first, int count, Output colormap, unsigned char* clipped) const = 0;
+    virtual int update(int n, Output colormap, unsigned char* clipped,
+            const GeneratorImplementation& previous, int* computed) const = 0;
+    virtual int eval(int count, const float* t, Output colormap) const = 0;
+};
+
+template<typename T>
+class generator_implementation : public GeneratorImplementation {
+public:
+    T type;
+
+    generator_implementation(const T& type) : type(type)
+    {
+    }
+
+    int generate(int n, int first, int count, Output colormap, unsigned char* clipped) const override
+    {
+        return compute_entries(type, n, first, count, colormap, clipped);
+    }
+
+    int update(int n, Output colormap, unsigned char* clipped,
+            const GeneratorImplementation& previous, int* computed) const override
+    {
+        const generator_implementation<T>* p = dynamic_cast<const generator_implementation<T>*>(&previous);
+        std::vector<unsigned char> changed(n);
+        if (!p || !changed_entries(type, p->type, n, changed.data())) {
+            *computed = n;
+            return compute_entries(type, n, 0, n, colormap, clipped);
+        }
+        // Recompute each range of consecutive changed entries
+        *computed = 0;
+        for (int i = 0; i < n;) {
+            if (!changed[i]) {
+                i++;
+                continue;
+            }
+            int j = i + 1;
+            while (j < n && changed[j])
+                j++;
+            compute_entries(type, n, i, j - i, offset(colormap, i), clipped + i);
+            *computed += j - i;
+            i = j;
+        }
+        int clipped_colors = 0;
+        for (int i = 0; i < n; i++)
+            clipped_colors += clipped[i];
+        return clipped_colors;
+    }
+
+    int eval(int count, const float* t, Output colormap) const override
+    {
+        return compute_positions(type, count, t, colormap);
+    }
+};
+
+template<typename T>
+static std::shared_ptr<const GeneratorImplementation> make_implementation(const T& type)
+{
+    return std::make_shared<generator_implementation<T>>(type);
+}
+
+Generator::Generator(std::shared_ptr<const GeneratorImplementation> impl) : _impl(impl)
+{
+}
+
+Generator Generator::BrewerSequential(float hue,
+        float contrast, float saturation, float brightness, float warmth)
+{
+    return Generator(make_implementation(brewer_sequential(hue, contrast, saturation, brightness, warmth)));
+}
+
+Generator Generator::BrewerDiverging(float hue, float divergence,
+        float contrast, float saturation, float brightness, float warmth)
+{
+    return Generator(make_implementation(brewer_diverging(hue, divergence, contrast, saturation, brightness, warmth)));
+}
+
+Generator Generator::BrewerQualitative(float hue, float divergence,
+        float contrast, float saturation, float brightness, bool stable_order)
+{
+    return Generator(make_implementation(brewer_qualitative(hue, divergence, contrast, saturation, brightness,
+                    stable_order)));
+}
+
+Generator Generator::PUSequentialLightness(
+        float lightness_range, float saturation_range, float saturation, float hue)
+{
+    return Generator(make_implementation(pu_sequential_lightness(lightness_range, saturation_range, saturation, hue)));
+}
+
+Generator Generator::PUSequentialSaturation(
+        float saturation_range, float lightness, float saturation, float hue)
+{
+    return Generator(make_implementation(pu_sequential_saturation(saturation_range, lightness, saturation, hue)));
+}
+
+Generator Generator::PUSequentialRainbow(
+        float lightness_range, float saturation_range,
+        float hue, float rotations, float saturation)
+{
+    return Generator(make_implementation(pu_sequential_rainbow(lightness_range, saturation_range,
+                    hue, rotations, saturation)));
+}
+
+Generator Generator::PUSequentialBlackBody(
+        float temperature, float temperature_range,
+        float lightness_range, float saturation_range, float saturation)
+{
+    return Generator(make_implementation(pu_sequential_black_body(temperature, temperature_range,
+                    lightness_range, saturation_range, saturation)));
+}
+
+Generator Generator::PUSequentialMultiHue(
+        float lightness_range, float saturation_range, float saturation,
+        int hues, const float* hue_values, const float* hue_positions)
+{
+    return Generator(make_implementation(pu_sequential_multi_hue(lightness_range, saturation_range, saturation,
+                    hues, hue_values, hue_positions)));
+}
+
+Generator Generator::PUDivergingLightness(
+        float lightness_range, float saturation_range, float saturation, float hue, float divergence)
+{
+    return Generator(make_implementation(pu_diverging_lightness(lightness_range, saturation_range, saturation,
+                    hue, divergence)));
+}
+
+Generator Generator::PUDivergingSaturation(
+        float saturation_range, float lightness, float saturation, float hue, float divergence)
+{
+    return Generator(make_implementation(pu_diverging_saturation(saturation_range, lightness, saturation,
+                    hue, divergence)));
+}
+
+Generator Generator::PUQualitativeHue(
+        float hue, float divergence, float lightness, float saturation, bool stable_order)
+{
+    return Generator(make_implementation(pu_qualitative_hue(hue, divergence, lightness, saturation,
+                    stable_order)));
+}
+
+Generator Generator::CubeHelix(float hue, float rotations, float saturation, float gamma)
+{
+    return Generator(make_implementation(cube_helix(hue, rotations, saturation, gamma)));
+}
+
+Generator Generator::Moreland(
+        unsigned char sr0, unsigned char sg0, unsigned char sb0,
+        unsigned char sr1, unsigned char sg1, unsigned char sb1)
+{
+    return Generator(make_implementation(moreland(sr0, sg0, sb0, sr1, sg1, sb1)));
+}
+
+Generator Generator::McNames(float periods)
+{
+    return Generator(make_implementation(mcnames(periods)));
+}
+
+int Generator::Generate(int n, Output colormap) const
+{
+    return _impl->generate(n, 0, n, colormap, NULL);
+}
+
+int Generator::Generate(int n, int first, int count, Output colormap) const
+{
+    return _impl->generate(n, first, count, colormap, NULL);
+}
+
+int Generator::Generate(int n, Output colormap, unsigned char* clipped) const
+{
+    return _impl->generate(n, 0, n, colormap, clipped);
+}
+
+int Generator::Update(int n, Output colormap, unsigned char* clipped,
+        const Generator& previous, int* computed) const
+{
+    int computed_entries;
+    int clipped_colors = _impl->update(n, colormap, clipped, *previous._impl, &computed_entries);
+    if (computed)
+        *computed = computed_entries;
+    return clipped_colors;
+}
+
+
+int Generator::Eval(float t, Output colormap) const
+{
+    return _impl->eval(1, &t, colormap);
+}
+
+int Generator::Eval(int count, const float* t, Output colormap) const
+{
+    return _impl->eval(count, t, colormap);
+}
+
+
+/* Applying color maps */
+
+// Each thread processes at least this many data values
+static const size_t min_values_per_thread = 65536;
+
+// The values are processed in tiles of this size: first the color map
+// indices of a tile are computed in a loop that the compiler can vectorize,
+// then the colors are looked up.
+static const int apply_tile_size = 1024;
+
+// Compute the indices of m data values into a color map with n entries that
+// is followed by the NaN color. The scale must be finite and nonzero, which
+// requires a finite vmin, so that the product below is NaN only for NaN data.
+static void apply_indices(int m, const float* data, float vmin, float scale, int n, int* indices)
+{
+    float max_index = n - 1;
+    float nan_index = n;
+    for (int j = 0; j < m; j++) {
+        // NaN is the only value that is not equal to itself
+        float x = clamp((data[j] - vmin) * scale, 0.0f, max_index);
+        indices[j] = static_cast<int>(data[j] == data[j] ? x : nan_index);
+    }
+}
+
+// The same for a range that cannot be divided into intervals: values up to
+// vmin (or from vmin on if the map is reversed) get the first color, all
+// others the last. The difference is NaN if data and vmin are the same
+// infinity, and then the first color is used, too.
+static void apply_indices_degenerate(int m, const float* data, float vmin, float direction, int n, int* indices)
+{
+    for (int j = 0; j < m; j++) {
+        if (data[j] != data[j])
+            indices[j] = n;
+        else
+            indices[j] = ((data[j] - vmin) * direction > 0.0f ? n - 1 : 0);
+    }
+}
+
+void Apply(const float* data, size_t count, float vmin, float vmax,
+        const unsigned char* srgb_colormap, int n, unsigned char* srgb_result,
+        unsigned char nan_r, unsigned char nan_g, unsigned char nan_b)
+{
+    // Without colors, every value gets the NaN color
+    if (n < 1) {
+        for (size_t i = 0; i < count; i++) {
+            srgb_result[3 * i + 0] = nan_r;
+            srgb_result[3 * i + 1] = nan_g;
+            srgb_result[3 * i + 2] = nan_b;
+        }
+        return;
+    }
+
+    // Color map entries followed by the NaN color, so that every value
+    // has an index into this table
+    std::vector<unsigned char> lut(3 * (n + 1));
+    std::memcpy(lut.data(), srgb_colormap, 3 * n);
+    lut[3 * n + 0] = nan_r;
+    lut[3 * n + 1] = nan_g;
+    lut[3 * n + 2] = nan_b;
+
+    // The scale is zero or not finite if vmin == vmax, if a bound is
+    // infinite, or if vmax - vmin overflows
+    float scale = n / (vmax - vmin);
+    bool degenerate = !(std::isfinite(scale) && scale != 0.0f);
+    float direction = (vmax < vmin ? -1.0f : 1.0f);
+    auto apply_range = [&](int, size_t begin, size_t end) {
+        int indices[apply_tile_size];
+        for (size_t i0 = begin; i0 < end; i0 += apply_tile_size) {
+            int m = std::min(static_cast<size_t>(apply_tile_size), end - i0);
+            if (degenerate)
+                apply_indices_degenerate(m, data + i0, vmin, direction, n, indices);
+            else
+                apply_indices(m, data + i0, vmin, scale, n, indices);
+            unsigned char* r = srgb_result + 3 * i0;
+            for (int j = 0; j < m; j++) {
+                r[3 * j + 0] = lut[3 * indices[j] + 0];
+                r[3 * j + 1] = lut[3 * indices[j] + 1];
+                r[3 * j + 2] = lut[3 * indices[j] + 2];
+            }
+        }
+    };
+
+    int t = thread_count(count, min_values_per_thread);
+    if (t <= 1)
+        apply_range(0, 0, count);
+    else
+        run_ranges(count, t, apply_range);
+}
+
+/* Metrics */
+
+// The CIEDE2000 color difference, implemented as described in G. Sharma,
+// W. Wu, E. N. Dalal, The CIEDE2000 Color-Difference Formula: Implementation
+// Notes, Supplementary Test Data, and Mathematical Observations, 2005.
+static float ciede2000(triplet lab0, triplet lab1)
+{
+    const float deg = pi / 180.0f;
+    const float pow25_7 = 6103515625.0f; // 25^7
+
+    float c0 = std::hypot(lab0.a, lab0.b);
+    float c1 = std::hypot(lab1.a, lab1.b);
+    float cm7 = std::pow(0.5f * (c0 + c1), 7.0f);
+    float g = 0.5f * (1.0f - std::sqrt(cm7 / (cm7 + pow25_7)));
+    float a0 = (1.0f + g) * lab0.a;
+    float a1 = (1.0f + g) * lab1.a;
+    c0 = std::hypot(a0, lab0.b);
+    c1 = std::hypot(a1, lab1.b);
+    float h0 = (c0 > 0.0f ? std::atan2(lab0.b, a0) : 0.0f);
+    float h1 = (c1 > 0.0f ? std::atan2(lab1.b, a1) : 0.0f);
+    if (h0 < 0.0f)
+        h0 += twopi;
+    if (h1 < 0.0f)
+        h1 += twopi;
+
+    float dl = lab1.l - lab0.l;
+    float dc = c1 - c0;
+    float dh = 0.0f;
+    float hm = h0 + h1;
+    if (c0 * c1 > 0.0f) {
+        dh = h1 - h0;
+        if (dh > pi)
+            dh -= twopi;
+        else if (dh < -pi)
+            dh += twopi;
+        if (std::abs(h0 - h1) <= pi)
+            hm = 0.5f * (h0 + h1);
+        else if (h0 + h1 < twopi)
+            hm = 0.5f * (h0 + h1 + twopi);
+        else
+            hm = 0.5f * (h0 + h1 - twopi);
+    }
+    float dhh = 2.0f * std::sqrt(c0 * c1) * std::sin(0.5f * dh);
+
+    float lm = 0.5f * (lab0.l + lab1.l);
+    float cm = 0.5f * (c0 + c1);
+    float t = 1.0f - 0.17f * std::cos(hm - 30.0f * deg) + 0.24f * std::cos(2.0f * hm)
+        + 0.32f * std::cos(3.0f * hm + 6.0f * deg) - 0.20f * std::cos(4.0f * hm - 63.0f * deg);
+    float dtheta = 30.0f * deg * std::exp(-sqr((hm - 275.0f * deg) / (25.0f * deg)));
+    cm7 = std::pow(cm, 7.0f);
+    float rc = 2.0f * std::sqrt(cm7 / (cm7 + pow25_7));
+    float sl = 1.0f + 0.015f * sqr(lm - 50.0f) / std::sqrt(20.0f + sqr(lm - 50.0f));
+    float sc = 1.0f + 0.045f * cm;
+    float sh = 1.0f + 0.015f * cm * t;
+    float rt = -std::sin(2.0f * dtheta) * rc;
+    float x = dl / sl;
+    float y = dc / sc;
+    float z = dhh / sh;
+    return std::sqrt(std::max(x * x + y * y + z * z + rt * y * z, 0.0f));
+}
+
+static MetricsSteps step_statistics(int steps, const float* delta_e)
+{
+    MetricsSteps m;
+    double sum = 0.0;
+    double sum_sqr = 0.0;
+    m.min = delta_e[0];
+    m.max = delta_e[0];
+    for (int i = 0; i < steps; i++) {
+        m.min = std::min(m.min, delta_e[i]);
+        m.max = std::max(m.max, delta_e[i]);
+        sum += delta_e[i];
+        sum_sqr += static_cast<double>(delta_e[i]) * delta_e[i];
+    }
+    double mean = sum / steps;
+    m.mean = mean;
+    m.stddev = std::sqrt(std::max(sum_sqr / steps - mean * mean, 0.0));
+    m.total = sum;
+    m.variation = (mean > 0.0 ? m.stddev / mean : 0.0f);
+    return m;
+}
+
+Metrics ComputeMetrics(int n, const unsigned char* srgb_colormap, float* delta_e76, float* delta_e2000)
+{
+    Metrics m;
+    if (n < 2)
+        return m;
+    int steps = n - 1;
+    std::vector<float> e76_storage(delta_e76 ? 0 : steps);
+    std::vector<float> e2000_storage(delta_e2000 ? 0 : steps);
+    float* e76 = (delta_e76 ? delta_e76 : e76_storage.data());
+    float* e2000 = (delta_e2000 ? delta_e2000 : e2000_storage.data());
+
+    // Linear RGB values of all 8 bit sRGB values
+    float linear[256];
+    for (int i = 0; i < 256; i++)
+        linear[i] = srgb_to_rgb_helper(i / 255.0f);
+    auto lab = [&](int i) {
+        const unsigned char* c = srgb_colormap + 3 * i;
+        return xyz_to_lab(rgb_to_xyz(triplet(linear[c[0]], linear[c[1]], linear[c[2]])));
+    };
+    auto compute_steps = [&](int, int begin, int end) {
+        triplet lab0 = lab(begin);
+        for (int i = begin; i < end; i++) {
+            triplet lab1 = lab(i + 1);
+            e76[i] = std::sqrt(sqr(lab1.l - lab0.l) + sqr(lab1.a - lab0.a) + sqr(lab1.b - lab0.b));
+            e2000[i] = ciede2000(lab0, lab1);
+            lab0 = lab1;
+        }
+    };
+    int t = thread_count(steps, min_entries_per_thread);
+    if (t <= 1)
+        compute_steps(0, 0, steps);
+    else
+        run_ranges(steps, t, compute_steps);
+
+    m.delta_e76 = step_statistics(steps, e76);
+    m.delta_e2000 = step_statistics(steps, e2000);
+    return m;
+}
+
+float DeltaE2000(const float* srgb0, const float* srgb1)
+{
+    triplet lab0 = xyz_to_lab(rgb_to_xyz(srgb_to_rgb(triplet(srgb0[0], srgb0[1], srgb0[2]))));
+    triplet lab1 = xyz_to_lab(rgb_to_xyz(srgb_to_rgb(triplet(srgb1[0], srgb1[1], srgb1[2]))));
+    return ciede2000(lab0, lab1);
 }
 
 }
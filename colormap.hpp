@@ -25,6 +25,9 @@
 #ifndef COLORMAP_HPP
 #define COLORMAP_HPP
 
+#include <memory>
+#include <cstddef>
+
 /* Generate color maps for scientific visualization purposes.
  *
  * Usage:
@@ -35,12 +38,40 @@
  *   The return value is always the number of colors that had to be clipped
  *   to fit into sRGB; you want to keep that number low by adjusting parameters.
  *
- * All colors are represented as unsigned char sRGB triplets, with each value in
- * [0,255].
+ * By default, all colors are represented as unsigned char sRGB triplets, with
+ * each value in [0,255]. Other output formats can be requested by passing an
+ * Output instead of an unsigned char pointer; see below.
  */
 
 namespace ColorMap {
 
+/*
+ * Output formats
+ *
+ * Each color map entry consists of three values (red, green, blue) of the
+ * type given below. Colors are clipped to the sRGB gamut in all formats, and
+ * clipping is reported in the same way.
+ */
+
+enum Format {
+    SRGB8,              // unsigned char sRGB values in [0,255]
+    SRGB16,             // unsigned short sRGB values in [0,65535]
+    SRGBHalf,           // half float sRGB values in [0,1], stored as unsigned short
+    SRGBFloat,          // float sRGB values in [0,1]
+    LinearRGB16,        // unsigned short linear RGB values in [0,65535]
+    LinearRGBHalf,      // half float linear RGB values in [0,1], stored as unsigned short
+    LinearRGBFloat      // float linear RGB values in [0,1]
+};
+
+class Output {
+public:
+    Format format;
+    void* data;
+
+    Output(unsigned char* srgb8_colormap) : format(SRGB8), data(srgb8_colormap) {}
+    Output(Format format, void* colormap) : format(format), data(colormap) {}
+};
+
 /*
  * Brewer-like color maps, as described in
  * M. Wijffelaars, R. Vliegen, J.J. van Wijk, E.-J. van der Linden. Generating
@@ -57,7 +88,7 @@ const float BrewerSequentialDefaultSaturation = 0.6f;
 const float BrewerSequentialDefaultBrightness = 0.75f;
 const float BrewerSequentialDefaultWarmth = 0.15f;
 
-int BrewerSequential(int n, unsigned char* srgb_colormap,
+int BrewerSequential(int n, Output colormap,
         float hue = BrewerSequentialDefaultHue,
         float contrast = BrewerSequentialDefaultContrast,
         float saturation = BrewerSequentialDefaultSaturation,
@@ -77,7 +108,7 @@ const float BrewerDivergingDefaultSaturation = 0.6f;
 const float BrewerDivergingDefaultBrightness = 0.75f;
 const float BrewerDivergingDefaultWarmth = 0.15f;
 
-int BrewerDiverging(int n, unsigned char* srgb_colormap,
+int BrewerDiverging(int n, Output colormap,
         float hue = BrewerDivergingDefaultHue,
         float divergence = BrewerDivergingDefaultDivergence,
         float contrast = BrewerDivergingDefaultContrast,
@@ -89,19 +120,28 @@ int BrewerDiverging(int n, unsigned char* srgb_colormap,
 // saturation; lightness and hue will differ. The parameter hue sets the hue of
 // the first color, and the parameter divergence defines the hue range starting
 // from that hue that can be used for the colors.
+//
+// By default, the hues of a qualitative map are evenly spaced for the given n,
+// so all colors change when n changes. With stable_order, color i is the same
+// for every n instead: the hue positions follow the golden ratio sequence
+// t_i = frac(i * 0.618...), each prefix of which is spread evenly over the
+// hue range. Adding colors then never changes the existing ones. This holds
+// for both qualitative map types.
 
 const float BrewerQualitativeDefaultHue = 0.0f;
 const float BrewerQualitativeDefaultDivergence = 4.18879020479f; // 2/3 * 2PI
 const float BrewerQualitativeDefaultContrast = 0.5f;
 const float BrewerQualitativeDefaultSaturation = 0.5f;
 const float BrewerQualitativeDefaultBrightness = 0.8f;
+const bool BrewerQualitativeDefaultStableOrder = false;
 
-int BrewerQualitative(int n, unsigned char* colormap,
+int BrewerQualitative(int n, Output colormap,
         float hue = BrewerQualitativeDefaultHue,
         float divergence = BrewerQualitativeDefaultDivergence,
         float contrast = BrewerQualitativeDefaultContrast,
         float saturation = BrewerQualitativeDefaultSaturation,
-        float brightness = BrewerQualitativeDefaultBrightness);
+        float brightness = BrewerQualitativeDefaultBrightness,
+        bool stable_order = BrewerQualitativeDefaultStableOrder);
 
 /*
  * Perceptually unifrom (PU) color maps.
@@ -127,7 +167,7 @@ const float PUSequentialLightnessDefaultSaturationRange = 0.95f;
 const float PUSequentialLightnessDefaultSaturation = 0.42f;
 const float PUSequentialLightnessDefaultHue = 0.349065850399f; // 20 deg
 
-int PUSequentialLightness(int n, unsigned char* colormap,
+int PUSequentialLightness(int n, Output colormap,
         float lightness_range = PUSequentialLightnessDefaultLightnessRange,
         float saturation_range = PUSequentialLightnessDefaultSaturationRange,
         float saturation = PUSequentialLightnessDefaultSaturation,
@@ -140,7 +180,7 @@ const float PUSequentialSaturationDefaultLightness = 0.5f;
 const float PUSequentialSaturationDefaultSaturation = PUSequentialLightnessDefaultSaturation;
 const float PUSequentialSaturationDefaultHue = 0.349065850399f; // 20 deg
 
-int PUSequentialSaturation(int n, unsigned char* colormap,
+int PUSequentialSaturation(int n, Output colormap,
         float saturation_range = PUSequentialSaturationDefaultSaturationRange,
         float lightness = PUSequentialSaturationDefaultLightness,
         float saturation = PUSequentialSaturationDefaultSaturation,
@@ -154,7 +194,7 @@ const float PUSequentialRainbowDefaultHue = 0.0f;
 const float PUSequentialRainbowDefaultRotations = -1.5f;
 const float PUSequentialRainbowDefaultSaturation = 0.8f;
 
-int PUSequentialRainbow(int n, unsigned char* colormap,
+int PUSequentialRainbow(int n, Output colormap,
         float lightness_range = PUSequentialRainbowDefaultLightnessRange,
         float saturation_range = PUSequentialRainbowDefaultSaturationRange,
         float hue = PUSequentialRainbowDefaultHue,
@@ -172,7 +212,7 @@ const float PUSequentialBlackBodyDefaultLightnessRange = PUSequentialLightnessDe
 const float PUSequentialBlackBodyDefaultSaturationRange = PUSequentialLightnessDefaultSaturationRange;
 const float PUSequentialBlackBodyDefaultSaturation = 1.4f;
 
-int PUSequentialBlackBody(int n, unsigned char* colormap,
+int PUSequentialBlackBody(int n, Output colormap,
         float temperature = PUSequentialBlackBodyDefaultTemperature,
         float temperature_range = PUSequentialBlackBodyDefaultTemperatureRange,
         float lightness_range = PUSequentialBlackBodyDefaultLightnessRange,
@@ -187,7 +227,7 @@ const int PUSequentialMultiHueDefaultHues = 2; // number of hues defined in the
 const float PUSequentialMultiHueDefaultHueValues[] = { 0.0f, 1.0471975512f }; // hues values in radians in [0,2pi]
 const float PUSequentialMultiHueDefaultHuePositions[] = { 0.25f, 0.75f }; // hue positions in [0,1] sorted in ascending order
 
-int PUSequentialMultiHue(int n, unsigned char* colormap,
+int PUSequentialMultiHue(int n, Output colormap,
         float lightness_range = PUSequentialMultiHueDefaultLightnessRange,
         float saturation_range = PUSequentialMultiHueDefaultSaturationRange,
         float saturation = PUSequentialMultiHueDefaultSaturation,
@@ -205,7 +245,7 @@ const float PUDivergingLightnessDefaultSaturation = PUSequentialLightnessDefault
 const float PUDivergingLightnessDefaultHue = 0.349065850399f; // 20 deg
 const float PUDivergingLightnessDefaultDivergence = 4.18879020479f; // 2/3 * 2PI
 
-int PUDivergingLightness(int n, unsigned char* colormap,
+int PUDivergingLightness(int n, Output colormap,
         float lightness_range = PUDivergingLightnessDefaultLightnessRange,
         float saturation_range = PUDivergingLightnessDefaultSaturationRange,
         float saturation = PUDivergingLightnessDefaultSaturation,
@@ -220,7 +260,7 @@ const float PUDivergingSaturationDefaultSaturation = 0.45f;
 const float PUDivergingSaturationDefaultHue = 0.349065850399f; // 20 deg
 const float PUDivergingSaturationDefaultDivergence = 4.18879020479f; // 2/3 * 2PI
 
-int PUDivergingSaturation(int n, unsigned char* colormap,
+int PUDivergingSaturation(int n, Output colormap,
         float saturation_range = PUSequentialSaturationDefaultSaturationRange,
         float lightness = PUDivergingSaturationDefaultLightness,
         float saturation = PUDivergingSaturationDefaultSaturation,
@@ -233,12 +273,14 @@ const float PUQualitativeHueDefaultHue = 0.0f;
 const float PUQualitativeHueDefaultDivergence = 4.18879020479f; // 2/3 * 2PI
 const float PUQualitativeHueDefaultLightness = 0.55f;
 const float PUQualitativeHueDefaultSaturation = 0.15f;
+const bool PUQualitativeHueDefaultStableOrder = false; // see BrewerQualitative
 
-int PUQualitativeHue(int n, unsigned char* colormap,
+int PUQualitativeHue(int n, Output colormap,
         float hue = PUQualitativeHueDefaultHue,
         float divergence = PUQualitativeHueDefaultDivergence,
         float lightness = PUQualitativeHueDefaultLightness,
-        float saturation = PUQualitativeHueDefaultSaturation);
+        float saturation = PUQualitativeHueDefaultSaturation,
+        bool stable_order = PUQualitativeHueDefaultStableOrder);
 
 /*
  * CubeHelix color maps, as described in
@@ -258,7 +300,7 @@ const float CubeHelixDefaultRotations = -1.5f;
 const float CubeHelixDefaultSaturation = 1.2f;
 const float CubeHelixDefaultGamma = 1.0f;
 
-int CubeHelix(int n, unsigned char* colormap,
+int CubeHelix(int n, Output colormap,
         float hue = CubeHelixDefaultHue,
         float rotations = CubeHelixDefaultRotations,
         float saturation = CubeHelixDefaultSaturation,
@@ -280,7 +322,7 @@ const unsigned char MorelandDefaultR1 = 59;
 const unsigned char MorelandDefaultG1 = 76;
 const unsigned char MorelandDefaultB1 = 192;
 
-int Moreland(int n, unsigned char* colormap,
+int Moreland(int n, Output colormap,
         unsigned char sr0 = MorelandDefaultR0,
         unsigned char sg0 = MorelandDefaultG0,
         unsigned char sb0 = MorelandDefaultB0,
@@ -301,9 +343,273 @@ int Moreland(int n, unsigned char* colormap,
 
 const float McNamesDefaultPeriods = 2.0f;
 
-int McNames(int n, unsigned char* colormap,
+int McNames(int n, Output colormap,
         float periods = McNamesDefaultPeriods);
 
+/*
+ * Generators
+ *
+ * A generator stores the parameters of one of the color map types above
+ * together with everything that can be precomputed from them. Use it to
+ * compute the same color map repeatedly, e.g. for different n, or to compute
+ * only a part of a color map. The results are the same as for the
+ * corresponding function. Generators are cheap to copy, and a generator can
+ * be used by several threads at the same time.
+ */
+
+class GeneratorImplementation;
+
+class Generator {
+public:
+    // Create a generator. The parameters are the same as for the function
+    // of the same name above.
+    static Generator BrewerSequential(
+            float hue = BrewerSequentialDefaultHue,
+            float contrast = BrewerSequentialDefaultContrast,
+            float saturation = BrewerSequentialDefaultSaturation,
+            float brightness = BrewerSequentialDefaultBrightness,
+            float warmth = BrewerSequentialDefaultWarmth);
+    static Generator BrewerDiverging(
+            float hue = BrewerDivergingDefaultHue,
+            float divergence = BrewerDivergingDefaultDivergence,
+            float contrast = BrewerDivergingDefaultContrast,
+            float saturation = BrewerDivergingDefaultSaturation,
+            float brightness = BrewerDivergingDefaultBrightness,
+            float warmth = BrewerDivergingDefaultWarmth);
+    static Generator BrewerQualitative(
+            float hue = BrewerQualitativeDefaultHue,
+            float divergence = BrewerQualitativeDefaultDivergence,
+            float contrast = BrewerQualitativeDefaultContrast,
+            float saturation = BrewerQualitativeDefaultSaturation,
+            float brightness = BrewerQualitativeDefaultBrightness,
+            bool stable_order = BrewerQualitativeDefaultStableOrder);
+    static Generator PUSequentialLightness(
+            float lightness_range = PUSequentialLightnessDefaultLightnessRange,
+            float saturation_range = PUSequentialLightnessDefaultSaturationRange,
+            float saturation = PUSequentialLightnessDefaultSaturation,
+            float hue = PUSequentialLightnessDefaultHue);
+    static Generator PUSequentialSaturation(
+            float saturation_range = PUSequentialSaturationDefaultSaturationRange,
+            float lightness = PUSequentialSaturationDefaultLightness,
+            float saturation = PUSequentialSaturationDefaultSaturation,
+            float hue = PUSequentialSaturationDefaultHue);
+    static Generator PUSequentialRainbow(
+            float lightness_range = PUSequentialRainbowDefaultLightnessRange,
+            float saturation_range = PUSequentialRainbowDefaultSaturationRange,
+            float hue = PUSequentialRainbowDefaultHue,
+            float rotations = PUSequentialRainbowDefaultRotations,
+            float saturation = PUSequentialRainbowDefaultSaturation);
+    static Generator PUSequentialBlackBody(
+            float temperature = PUSequentialBlackBodyDefaultTemperature,
+            float temperature_range = PUSequentialBlackBodyDefaultTemperatureRange,
+            float lightness_range = PUSequentialBlackBodyDefaultLightnessRange,
+            float saturation_range = PUSequentialBlackBodyDefaultSaturationRange,
+            float saturation = PUSequentialBlackBodyDefaultSaturation);
+    static Generator PUSequentialMultiHue( // the hue values and positions are copied
+            float lightness_range = PUSequentialMultiHueDefaultLightnessRange,
+            float saturation_range = PUSequentialMultiHueDefaultSaturationRange,
+            float saturation = PUSequentialMultiHueDefaultSaturation,
+            int hues = PUSequentialMultiHueDefaultHues,
+            const float* hue_values = PUSequentialMultiHueDefaultHueValues,
+            const float* hue_positions = PUSequentialMultiHueDefaultHuePositions);
+    static Generator PUDivergingLightness(
+            float lightness_range = PUDivergingLightnessDefaultLightnessRange,
+            float saturation_range = PUDivergingLightnessDefaultSaturationRange,
+            float saturation = PUDivergingLightnessDefaultSaturation,
+            float hue = PUDivergingLightnessDefaultHue,
+            float divergence = PUDivergingLightnessDefaultDivergence);
+    static Generator PUDivergingSaturation(
+            float saturation_range = PUSequentialSaturationDefaultSaturationRange,
+            float lightness = PUDivergingSaturationDefaultLightness,
+            float saturation = PUDivergingSaturationDefaultSaturation,
+            float hue = PUDivergingSaturationDefaultHue,
+            float divergence = PUDivergingSaturationDefaultDivergence);
+    static Generator PUQualitativeHue(
+            float hue = PUQualitativeHueDefaultHue,
+            float divergence = PUQualitativeHueDefaultDivergence,
+            float lightness = PUQualitativeHueDefaultLightness,
+            float saturation = PUQualitativeHueDefaultSaturation,
+            bool stable_order = PUQualitativeHueDefaultStableOrder);
+    static Generator CubeHelix(
+            float hue = CubeHelixDefaultHue,
+            float rotations = CubeHelixDefaultRotations,
+            float saturation = CubeHelixDefaultSaturation,
+            float gamma = CubeHelixDefaultGamma);
+    static Generator Moreland(
+            unsigned char sr0 = MorelandDefaultR0,
+            unsigned char sg0 = MorelandDefaultG0,
+            unsigned char sb0 = MorelandDefaultB0,
+            unsigned char sr1 = MorelandDefaultR1,
+            unsigned char sg1 = MorelandDefaultG1,
+            unsigned char sb1 = MorelandDefaultB1);
+    static Generator McNames(
+            float periods = McNamesDefaultPeriods);
+
+    // Compute a color map with n colors. Return the number of clipped colors.
+    int Generate(int n, Output colormap) const;
+
+    // Compute only the count colors starting with color number first of a
+    // color map with n colors. Return the number of clipped colors.
+    int Generate(int n, int first, int count, Output colormap) const;
+
+    // Compute a color map with n colors, and store for each color whether
+    // it was clipped (1) or not (0) in clipped, which must have room for n
+    // values. Return the number of clipped colors.
+    int Generate(int n, Output colormap, unsigned char* clipped) const;
+
+    // Update a color map with n colors that was computed by the generator
+    // previous with the same n and output format: colormap and clipped must
+    // contain its colors and clipped flags (see above), and are changed to
+    // the color map of this generator. Colors that cannot have changed are
+    // reused instead of computed again. Currently this is only done for
+    // PUSequentialMultiHue when only the hue values and positions change;
+    // editing one hue then only recomputes the colors of its neighboring
+    // segments. Return the number of clipped colors, and the number of
+    // computed colors in computed unless it is NULL.
+    int Update(int n, Output colormap, unsigned char* clipped,
+            const Generator& previous, int* computed = NULL) const;
+
+    // Compute the color at position t in [0,1] of the continuous color map,
+    // i.e. without quantizing t to one of n entries first. This writes a
+    // single color. Return 1 if the color was clipped and 0 otherwise.
+    // Color number i of a map with n colors is usually identical to the
+    // color at t=(i+0.5)/n, but the middle of discrete Brewer-like diverging
+    // maps, the halves of PU diverging maps with odd n, and the hue range of
+    // PU qualitative maps depend on n, and qualitative maps with stable order
+    // place color i at t=frac(i * 0.618...) instead.
+    int Eval(float t, Output colormap) const;
+
+    // Compute the colors at count positions t[0], ..., t[count-1]. Positions
+    // outside of [0,1] are clamped, and NaN is treated as 0. Return the
+    // number of clipped colors.
+    int Eval(int count, const float* t, Output colormap) const;
+
+private:
+    std::shared_ptr<const GeneratorImplementation> _impl;
+
+    Generator(std::shared_ptr<const GeneratorImplementation> impl);
+};
+
+/*
+ * Applying color maps
+ *
+ * Map count data values to colors of a color map with n sRGB triplets and
+ * store the resulting sRGB triplets in srgb_result, which must have room for
+ * 3 * count values. The range [vmin,vmax] is divided into n intervals of equal
+ * size, one for each color; values outside of this range get the first or the
+ * last color. If vmin > vmax, the color map is reversed. NaN values get the
+ * given NaN color. If vmin == vmax, if a bound is infinite, or if vmax - vmin
+ * is too large for a float, the range cannot be divided: then values up to
+ * vmin (from vmin on if vmax < vmin) get the first color and all other values
+ * the last. If n < 1, all values get the NaN color. This is done in parallel
+ * if enabled (see SetThreads below).
+ */
+
+void Apply(const float* data, size_t count, float vmin, float vmax,
+        const unsigned char* srgb_colormap, int n, unsigned char* srgb_result,
+        unsigned char nan_r = 0, unsigned char nan_g = 0, unsigned char nan_b = 0);
+
+/*
+ * Perceptual uniformity metrics
+ *
+ * Measure the color differences between consecutive colors of a color map
+ * with n sRGB triplets, both as Delta E 1976 (the Euclidean distance in
+ * CIELAB) and as CIEDE2000 Delta E. In a perceptually uniform color map, all
+ * steps have the same size. This is done in parallel if enabled (see
+ * SetThreads below).
+ */
+
+class MetricsSteps {
+public:
+    float min = 0.0f;       // smallest step
+    float max = 0.0f;       // largest step
+    float mean = 0.0f;      // mean step
+    float stddev = 0.0f;    // standard deviation of the steps
+    float total = 0.0f;     // sum of all steps, i.e. the perceptual length of the map
+    float variation = 0.0f; // stddev / mean; 0 for perfectly uniform steps
+};
+
+class Metrics {
+public:
+    MetricsSteps delta_e76;
+    MetricsSteps delta_e2000;
+};
+
+// Compute the metrics of a color map. If delta_e76 or delta_e2000 is not NULL,
+// it must have room for n - 1 values, and the step between colors i and i + 1
+// is stored in it at index i. To find out where colors were clipped, use the
+// clipped flags computed by Generator::Generate.
+Metrics ComputeMetrics(int n, const unsigned char* srgb_colormap,
+        float* delta_e76 = NULL, float* delta_e2000 = NULL);
+
+// Compute the CIEDE2000 Delta E between two sRGB colors with components in [0,1].
+float DeltaE2000(const float* srgb0, const float* srgb1);
+
+/*
+ * Statistics
+ *
+ * If colormap.cpp is compiled with COLORMAP_STATISTICS defined, all color map
+ * computations record the time spent in their stages and count expensive
+ * operations. This is meant for finding out where the time goes; it slows
+ * down the computations and is therefore disabled by default. Times are
+ * summed over all threads. The transcendental function calls are counted in
+ * the main computation paths only.
+ */
+
+class Statistics {
+public:
+    double entries_time = 0.0;            // computing entries in their native color space, in seconds
+    double uniform_lc_time = 0.0;         // solving for uniform steps in PU maps (part of entries_time)
+    double s_max_time = 0.0;              // computing the maximum saturation (part of entries_time)
+    double conversion_time = 0.0;         // converting to the output format
+    long long colormaps = 0;              // number of computed color maps or position lists
+    long long entries = 0;                // number of computed colors
+    long long clipped = 0;                // number of clipped colors
+    long long uniform_lc_solves = 0;      // number of solves for uniform steps
+    long long uniform_lc_fallbacks = 0;   // number of those solves without a valid solution
+    long long distance_evaluations = 0;   // number of distance computations in LCH space
+    long long s_max_evaluations = 0;      // number of maximum saturation computations
+    long long most_saturated_solves = 0;  // number of exact most saturated color computations
+    long long black_body_integrations = 0;// number of exact black body hue computations
+    long long transcendental_calls = 0;   // number of sin, cos, atan2, and pow calls
+};
+
+// Return whether statistics are recorded, i.e. whether COLORMAP_STATISTICS
+// was defined.
+bool StatisticsEnabled();
+
+// Reset all statistics to zero.
+void ResetStatistics();
+
+// Get the statistics recorded since the last reset.
+Statistics GetStatistics();
+
+/*
+ * Global settings
+ *
+ * These affect all subsequent color map computations. Do not change them
+ * while color maps are being computed in other threads.
+ */
+
+// Use a precomputed table of the most saturated colors that fit into sRGB
+// instead of computing them exactly for each hue. This speeds up the
+// Brewer-like color maps. The deviation from the exact colors is about 0.02
+// in CIELUV (where L is in [0,100]). The table is built on first use.
+// Default: false.
+void UseMostSaturatedTable(bool use);
+
+// Use a precomputed table of black body hues for temperatures in [250,40000]
+// instead of integrating the black body spectrum for each color map entry.
+// This speeds up PUSequentialBlackBody. The deviation from the exact hues is
+// below 1e-4 radians. The table is built on first use. Default: false.
+void UseBlackBodyTable(bool use);
+
+// Set the number of threads used to compute each color map, or 0 to use one
+// thread per CPU core. Each thread computes a contiguous part of the color
+// map, so the result is identical to a single-threaded computation. Small
+// color maps are always computed in a single thread. Default: 1.
+void SetThreads(int threads);
+
 }
 
 #endif
@@ -22,6 +22,9 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
+#include <cstring>
+
 #include "gui.hpp"
 
 #include <QGridLayout>
@@ -125,46 +128,99 @@ void ColorMapCombinedSliderSpinBox::spinboxChanged()
 
 /* ColorMapWidget */
 
-ColorMapWidget::ColorMapWidget() : QWidget()
+ColorMapWidget::ColorMapWidget() : QWidget(),
+    _version(1), _cache_version(0), _cache_clipped(0)
 {
+    // This connection is made first, so the cache is invalid before
+    // any other receiver of the signal asks for the color map
+    connect(this, SIGNAL(colorMapChanged()), this, SLOT(invalidateColorMap()));
 }
 
 ColorMapWidget::~ColorMapWidget()
 {
 }
 
+QVector<unsigned char> ColorMapWidget::colorMap(int* clipped) const
+{
+    if (!colorMapCached()) {
+        int n;
+        ColorMap::Generator g = generator(n);
+        QVector<unsigned char> colormap(3 * n);
+        int cl = g.Generate(n, colormap.data());
+        setCachedColorMap(_version, colormap, cl);
+    }
+    if (clipped)
+        *clipped = _cache_clipped;
+    return _cache_colormap;
+}
+
+unsigned long long ColorMapWidget::colorMapVersion() const
+{
+    return _version;
+}
+
+bool ColorMapWidget::colorMapCached() const
+{
+    return _cache_version == _version;
+}
+
+void ColorMapWidget::setCachedColorMap(unsigned long long version, const QVector<unsigned char>& colormap, int clipped) const
+{
+    if (version == _version) {
+        _cache_version = version;
+        _cache_colormap = colormap;
+        _cache_clipped = clipped;
+    }
+}
+
+void ColorMapWidget::invalidateColorMap()
+{
+    _version++;
+}
+
 QImage ColorMapWidget::colorMapImage(const QVector<unsigned char>& colormap, int width, int height)
 {
-    QVector<QColor> qcolormap(colormap.size() / 3);
-    for (int i = 0; i < qcolormap.size(); i++)
-        qcolormap[i] = QColor(colormap[3 * i + 0], colormap[3 * i + 1], colormap[3 * i + 2]);
+    QImage img;
+    colorMapImage(colormap, width, height, img);
+    return img;
+}
+
+void ColorMapWidget::colorMapImage(const QVector<unsigned char>& colormap, int width, int height, QImage& img)
+{
+    int n = colormap.size() / 3;
+    const unsigned char* c = colormap.constData();
 
     if (width <= 0)
-        width = qcolormap.size();
+        width = n;
     if (height <= 0)
-        height = qcolormap.size();
-    QImage img(width, height, QImage::Format_RGB32);
+        height = n;
+    if (img.width() != width || img.height() != height || img.format() != QImage::Format_RGB32)
+        img = QImage(width, height, QImage::Format_RGB32);
     bool y_direction = (height > width);
     if (y_direction) {
+        // Each scanline has a single color
+        float entry_height = height / static_cast<float>(n);
         for (int y = 0; y < height; y++) {
-            float entry_height = height / static_cast<float>(qcolormap.size());
             int i = y / entry_height;
-            QRgb rgb = qcolormap[i].rgb();
             QRgb* scanline = reinterpret_cast<QRgb*>(img.scanLine(height - 1 - y));
-            for (int x = 0; x < width; x++)
-                scanline[x] = rgb;
+            std::fill(scanline, scanline + width, qRgb(c[3 * i + 0], c[3 * i + 1], c[3 * i + 2]));
         }
     } else {
-        for (int y = 0; y < height; y++) {
-            QRgb* scanline = reinterpret_cast<QRgb*>(img.scanLine(y));
-            for (int x = 0; x < width; x++) {
-                float entry_width = width / static_cast<float>(qcolormap.size());
-                int i = x / entry_width;
-                scanline[x] = qcolormap[i].rgb();
-            }
+        // All scanlines are identical
+        float entry_width = width / static_cast<float>(n);
+        QRgb* first_scanline = reinterpret_cast<QRgb*>(img.scanLine(0));
+        for (int x = 0; x < width; x++) {
+            int i = x / entry_width;
+            first_scanline[x] = qRgb(c[3 * i + 0], c[3 * i + 1], c[3 * i + 2]);
         }
+        for (int y = 1; y < height; y++)
+            std::memcpy(img.scanLine(y), first_scanline, width * sizeof(QRgb));
     }
-    return img;
+}
+
+QImage ColorMapWidget::colorMapRowImage(const QVector<unsigned char>& colormap)
+{
+    return QImage(colormap.constData(), colormap.size() / 3, 1, colormap.size(), QImage::Format_RGB888);
 }
 
 /* Helper functions for ColorMap*Widget */
@@ -261,16 +317,11 @@ void ColorMapBrewerSequentialWidget::reset()
     update();
 }
 
-QVector<unsigned char> ColorMapBrewerSequentialWidget::colorMap(int* clipped) const
+ColorMap::Generator ColorMapBrewerSequentialWidget::generator(int& n) const
 {
-    int n;
     float h, c, s, b, w;
     parameters(n, h, c, s, b, w);
-    QVector<unsigned char> colormap(3 * n);
-    int cl = ColorMap::BrewerSequential(n, colormap.data(), h, c, s, b, w);
-    if (clipped)
-        *clipped = cl;
-    return colormap;
+    return ColorMap::Generator::BrewerSequential(h, c, s, b, w);
 }
 
 QString ColorMapBrewerSequentialWidget::reference() const
@@ -378,16 +429,11 @@ void ColorMapBrewerDivergingWidget::reset()
     update();
 }
 
-QVector<unsigned char> ColorMapBrewerDivergingWidget::colorMap(int* clipped) const
+ColorMap::Generator ColorMapBrewerDivergingWidget::generator(int& n) const
 {
-    int n;
     float h, d, c, s, b, w;
     parameters(n, h, d, c, s, b, w);
-    QVector<unsigned char> colormap(3 * n);
-    int cl = ColorMap::BrewerDiverging(n, colormap.data(), h, d, c, s, b, w);
-    if (clipped)
-        *clipped = cl;
-    return colormap;
+    return ColorMap::Generator::BrewerDiverging(h, d, c, s, b, w);
 }
 
 QString ColorMapBrewerDivergingWidget::reference() const
@@ -497,16 +543,11 @@ void ColorMapBrewerQualitativeWidget::reset()
     update();
 }
 
-QVector<unsigned char> ColorMapBrewerQualitativeWidget::colorMap(int* clipped) const
+ColorMap::Generator ColorMapBrewerQualitativeWidget::generator(int& n) const
 {
-    int n;
     float h, d, c, s, b;
     parameters(n, h, d, c, s, b);
-    QVector<unsigned char> colormap(3 * n);
-    int cl = ColorMap::BrewerQualitative(n, colormap.data(), h, d, c, s, b);
-    if (clipped)
-        *clipped = cl;
-    return colormap;
+    return ColorMap::Generator::BrewerQualitative(h, d, c, s, b);
 }
 
 QString ColorMapBrewerQualitativeWidget::reference() const
@@ -598,16 +639,11 @@ void ColorMapPUSequentialLightnessWidget::reset()
     update();
 }
 
-QVector<unsigned char> ColorMapPUSequentialLightnessWidget::colorMap(int* clipped) const
+ColorMap::Generator ColorMapPUSequentialLightnessWidget::generator(int& n) const
 {
-    int n;
     float lr, sr, s, h;
     parameters(n, lr, sr, s, h);
-    QVector<unsigned char> colormap(3 * n);
-    int cl = ColorMap::PUSequentialLightness(n, colormap.data(), lr, sr, s, h);
-    if (clipped)
-        *clipped = cl;
-    return colormap;
+    return ColorMap::Generator::PUSequentialLightness(lr, sr, s, h);
 }
 
 QString ColorMapPUSequentialLightnessWidget::reference() const
@@ -697,16 +733,11 @@ void ColorMapPUSequentialSaturationWidget::reset()
     update();
 }
 
-QVector<unsigned char> ColorMapPUSequentialSaturationWidget::colorMap(int* clipped) const
+ColorMap::Generator ColorMapPUSequentialSaturationWidget::generator(int& n) const
 {
-    int n;
     float sr, l, s, h;
     parameters(n, sr, l, s, h);
-    QVector<unsigned char> colormap(3 * n);
-    int cl = ColorMap::PUSequentialSaturation(n, colormap.data(), sr, l, s, h);
-    if (clipped)
-        *clipped = cl;
-    return colormap;
+    return ColorMap::Generator::PUSequentialSaturation(sr, l, s, h);
 }
 
 QString ColorMapPUSequentialSaturationWidget::reference() const
@@ -804,16 +835,11 @@ void ColorMapPUSequentialRainbowWidget::reset()
     update();
 }
 
-QVector<unsigned char> ColorMapPUSequentialRainbowWidget::colorMap(int* clipped) const
+ColorMap::Generator ColorMapPUSequentialRainbowWidget::generator(int& n) const
 {
-    int n;
     float lr, sr, h, r, s;
     parameters(n, lr, sr, h, r, s);
-    QVector<unsigned char> colormap(3 * n);
-    int cl = ColorMap::PUSequentialRainbow(n, colormap.data(), lr, sr, h, r, s);
-    if (clipped)
-        *clipped = cl;
-    return colormap;
+    return ColorMap::Generator::PUSequentialRainbow(lr, sr, h, r, s);
 }
 
 QString ColorMapPUSequentialRainbowWidget::reference() const
@@ -914,16 +940,11 @@ void ColorMapPUSequentialBlackBodyWidget::reset()
     update();
 }
 
-QVector<unsigned char> ColorMapPUSequentialBlackBodyWidget::colorMap(int* clipped) const
+ColorMap::Generator ColorMapPUSequentialBlackBodyWidget::generator(int& n) const
 {
-    int n;
     float t, tr, lr, sr, s;
     parameters(n, t, tr, lr, sr, s);
-    QVector<unsigned char> colormap(3 * n);
-    int cl = ColorMap::PUSequentialBlackBody(n, colormap.data(), t, tr, lr, sr, s);
-    if (clipped)
-        *clipped = cl;
-    return colormap;
+    return ColorMap::Generator::PUSequentialBlackBody(t, tr, lr, sr, s);
 }
 
 QString ColorMapPUSequentialBlackBodyWidget::reference() const
@@ -1063,19 +1084,13 @@ void ColorMapPUSequentialMultiHueWidget::reset()
     update();
 }
 
-QVector<unsigned char> ColorMapPUSequentialMultiHueWidget::colorMap(int* clipped) const
+ColorMap::Generator ColorMapPUSequentialMultiHueWidget::generator(int& n) const
 {
-    int n;
     QVector<float> hue_values, hue_positions;
     float lr, sr, s;
     parameters(n, lr, sr, s, hue_values, hue_positions);
-    QVector<unsigned char> colormap(3 * n);
-    int cl = ColorMap::PUSequentialMultiHue(n, colormap.data(),
-            lr, sr, s,
+    return ColorMap::Generator::PUSequentialMultiHue(lr, sr, s,
             hue_values.size(), hue_values.data(), hue_positions.data());
-    if (clipped)
-        *clipped = cl;
-    return colormap;
 }
 
 QString ColorMapPUSequentialMultiHueWidget::reference() const
@@ -1234,16 +1249,11 @@ void ColorMapPUDivergingLightnessWidget::reset()
     update();
 }
 
-QVector<unsigned char> ColorMapPUDivergingLightnessWidget::colorMap(int* clipped) const
+ColorMap::Generator ColorMapPUDivergingLightnessWidget::generator(int& n) const
 {
-    int n;
     float lr, sr, s, h, d;
     parameters(n, lr, sr, s, h, d);
-    QVector<unsigned char> colormap(3 * n);
-    int cl = ColorMap::PUDivergingLightness(n, colormap.data(), lr, sr, s, h, d);
-    if (clipped)
-        *clipped = cl;
-    return colormap;
+    return ColorMap::Generator::PUDivergingLightness(lr, sr, s, h, d);
 }
 
 QString ColorMapPUDivergingLightnessWidget::reference() const
@@ -1342,16 +1352,11 @@ void ColorMapPUDivergingSaturationWidget::reset()
     update();
 }
 
-QVector<unsigned char> ColorMapPUDivergingSaturationWidget::colorMap(int* clipped) const
+ColorMap::Generator ColorMapPUDivergingSaturationWidget::generator(int& n) const
 {
-    int n;
     float sr, l, s, h, d;
     parameters(n, sr, l, s, h, d);
-    QVector<unsigned char> colormap(3 * n);
-    int cl = ColorMap::PUDivergingSaturation(n, colormap.data(), sr, l, s, h, d);
-    if (clipped)
-        *clipped = cl;
-    return colormap;
+    return ColorMap::Generator::PUDivergingSaturation(sr, l, s, h, d);
 }
 
 QString ColorMapPUDivergingSaturationWidget::reference() const
@@ -1442,16 +1447,11 @@ void ColorMapPUQualitativeHueWidget::reset()
     update();
 }
 
-QVector<unsigned char> ColorMapPUQualitativeHueWidget::colorMap(int* clipped) const
+ColorMap::Generator ColorMapPUQualitativeHueWidget::generator(int& n) const
 {
-    int n;
     float h, d, l, s;
     parameters(n, h, d, l, s);
-    QVector<unsigned char> colormap(3 * n);
-    int cl = ColorMap::PUQualitativeHue(n, colormap.data(), h, d, l, s);
-    if (clipped)
-        *clipped = cl;
-    return colormap;
+    return ColorMap::Generator::PUQualitativeHue(h, d, l, s);
 }
 
 QString ColorMapPUQualitativeHueWidget::reference() const
@@ -1541,16 +1541,11 @@ void ColorMapCubeHelixWidget::reset()
     update();
 }
 
-QVector<unsigned char> ColorMapCubeHelixWidget::colorMap(int* clipped) const
+ColorMap::Generator ColorMapCubeHelixWidget::generator(int& n) const
 {
-    int n;
     float h, r, s, g;
     parameters(n, h, r, s, g);
-    QVector<unsigned char> colormap(3 * n);
-    int cl = ColorMap::CubeHelix(n, colormap.data(), h, r, s, g);
-    if (clipped)
-        *clipped = cl;
-    return colormap;
+    return ColorMap::Generator::CubeHelix(h, r, s, g);
 }
 
 QString ColorMapCubeHelixWidget::reference() const
@@ -1683,16 +1678,11 @@ void ColorMapMorelandWidget::reset()
     update();
 }
 
-QVector<unsigned char> ColorMapMorelandWidget::colorMap(int* clipped) const
+ColorMap::Generator ColorMapMorelandWidget::generator(int& n) const
 {
-    int n;
     unsigned char r0, g0, b0, r1, g1, b1;
     parameters(n, r0, g0, b0, r1, g1, b1);
-    QVector<unsigned char> colormap(3 * n);
-    int cl = ColorMap::Moreland(n, colormap.data(), r0, g0, b0, r1, g1, b1);
-    if (clipped)
-        *clipped = cl;
-    return colormap;
+    return ColorMap::Generator::Moreland(r0, g0, b0, r1, g1, b1);
 }
 
 QString ColorMapMorelandWidget::reference() const
@@ -1764,16 +1754,11 @@ void ColorMapMcNamesWidget::reset()
     update();
 }
 
-QVector<unsigned char> ColorMapMcNamesWidget::colorMap(int* clipped) const
+ColorMap::Generator ColorMapMcNamesWidget::generator(int& n) const
 {
-    int n;
     float p;
     parameters(n, p);
-    QVector<unsigned char> colormap(3 * n);
-    int cl = ColorMap::McNames(n, colormap.data(), p);
-    if (clipped)
-        *clipped = cl;
-    return colormap;
+    return ColorMap::Generator::McNames(p);
 }
 
 QString ColorMapMcNamesWidget::reference() const
@@ -28,6 +28,8 @@
 #include <QVector>
 #include <QWidget>
 
+#include "colormap.hpp"
+
 class QSpinBox;
 class QSlider;
 class QDoubleSpinBox;
@@ -64,6 +66,12 @@ class ColorMapWidget : public QWidget
 {
 Q_OBJECT
 
+private:
+    unsigned long long _version;
+    mutable unsigned long long _cache_version;
+    mutable QVector<unsigned char> _cache_colormap;
+    mutable int _cache_clipped;
+
 public:
     ColorMapWidget();
     ~ColorMapWidget();
@@ -71,18 +79,47 @@ public:
     /* Reset all values to their method-specific defaults */
     virtual void reset() = 0;
 
+    /* Get a generator for the color map corresponding to the current values,
+     * and the number of colors in n. The generator does not refer to the widget,
+     * so it can be used in other threads. */
+    virtual ColorMap::Generator generator(int& n) const = 0;
+
     /* Get the color map corresponding to the current values as a vector of colors.
-     * Also return the number of clipped colors unless 'clipped' is NULL. */
-    virtual QVector<unsigned char> colorMap(int* clipped = NULL) const = 0;
+     * Also return the number of clipped colors unless 'clipped' is NULL.
+     * The color map is cached until the values change, so repeated calls are cheap. */
+    QVector<unsigned char> colorMap(int* clipped = NULL) const;
+
+    /* Get the version of the current values. It changes whenever
+     * colorMapChanged() is emitted. */
+    unsigned long long colorMapVersion() const;
+
+    /* Return whether the color map for the current values is cached. */
+    bool colorMapCached() const;
+
+    /* Store a color map that was computed elsewhere, e.g. in another thread,
+     * from the values with the given version. It is ignored if the values
+     * have changed in the meantime. */
+    void setCachedColorMap(unsigned long long version, const QVector<unsigned char>& colormap, int clipped) const;
 
     /* Transform a color map to an image of the specified size. If width or
      * height is zero, then it will be set to the number of colors in the
      * color map. */
     static QImage colorMapImage(const QVector<unsigned char>& colormap, int width, int height);
+    /* Same, but render into an existing image. Its pixel buffer is reused if
+     * it already has the requested size and format and is not shared. */
+    static void colorMapImage(const QVector<unsigned char>& colormap, int width, int height, QImage& img);
+
+    /* Get an image of size n x 1 for a color map with n colors. The image
+     * refers to the color map data instead of copying it, so the color map
+     * must remain unchanged while the image is used. */
+    static QImage colorMapRowImage(const QVector<unsigned char>& colormap);
 
     /* Get a rich text string containing the relevant literature reference for this method */
     virtual QString reference() const = 0;
 
+private slots:
+    void invalidateColorMap();
+
 signals:
     void colorMapChanged();
 };
@@ -106,7 +143,7 @@ public:
     ~ColorMapBrewerSequentialWidget();
 
     void reset() override;
-    QVector<unsigned char> colorMap(int* clipped = NULL) const override;
+    ColorMap::Generator generator(int& n) const override;
     QString reference() const override;
     void parameters(int& n, float& hue,
             float& contrast, float& saturation, float& brightness, float& warmth) const;
@@ -132,7 +169,7 @@ public:
     ~ColorMapBrewerDivergingWidget();
 
     void reset() override;
-    QVector<unsigned char> colorMap(int* clipped = NULL) const override;
+    ColorMap::Generator generator(int& n) const override;
     QString reference() const override;
     void parameters(int& n, float& hue, float& divergence,
             float& contrast, float& saturation, float& brightness, float& warmth) const;
@@ -157,7 +194,7 @@ public:
     ~ColorMapBrewerQualitativeWidget();
 
     void reset() override;
-    QVector<unsigned char> colorMap(int* clipped = NULL) const override;
+    ColorMap::Generator generator(int& n) const override;
     QString reference() const override;
     void parameters(int& n, float& hue, float& divergence,
             float& contrast, float& saturation, float& brightness) const;
@@ -181,7 +218,7 @@ public:
     ~ColorMapPUSequentialLightnessWidget();
 
     void reset() override;
-    QVector<unsigned char> colorMap(int* clipped = NULL) const override;
+    ColorMap::Generator generator(int& n) const override;
     QString reference() const override;
     void parameters(int& n, float& lightness_range, float& saturation_range, float& saturation, float& hue) const;
 };
@@ -204,7 +241,7 @@ public:
     ~ColorMapPUSequentialSaturationWidget();
 
     void reset() override;
-    QVector<unsigned char> colorMap(int* clipped = NULL) const override;
+    ColorMap::Generator generator(int& n) const override;
     QString reference() const override;
     void parameters(int& n, float& saturation_range, float& lightness, float& saturation, float& hue) const;
 };
@@ -228,7 +265,7 @@ public:
     ~ColorMapPUSequentialRainbowWidget();
 
     void reset() override;
-    QVector<unsigned char> colorMap(int* clipped = NULL) const override;
+    ColorMap::Generator generator(int& n) const override;
     QString reference() const override;
     void parameters(int& n, float& lightness_range, float& saturation_range, float& hue, float& rotations, float& saturation) const;
 };
@@ -252,7 +289,7 @@ public:
     ~ColorMapPUSequentialBlackBodyWidget();
 
     void reset() override;
-    QVector<unsigned char> colorMap(int* clipped = NULL) const override;
+    ColorMap::Generator generator(int& n) const override;
     QString reference() const override;
     void parameters(int& n, float& temperature, float& temperature_range, float& lightness_range, float& saturation_range, float& saturation) const;
 };
@@ -283,7 +320,7 @@ public:
     ~ColorMapPUSequentialMultiHueWidget();
 
     void reset() override;
-    QVector<unsigned char> colorMap(int* clipped = NULL) const override;
+    ColorMap::Generator generator(int& n) const override;
     QString reference() const override;
     void parameters(int& n,
             float& lr, float& sr, float& s,
@@ -309,7 +346,7 @@ public:
     ~ColorMapPUDivergingLightnessWidget();
 
     void reset() override;
-    QVector<unsigned char> colorMap(int* clipped = NULL) const override;
+    ColorMap::Generator generator(int& n) const override;
     QString reference() const override;
     void parameters(int& n, float& lightness_range, float& saturation_range, float& saturation, float& hue, float& divergence) const;
 };
@@ -333,7 +370,7 @@ public:
     ~ColorMapPUDivergingSaturationWidget();
 
     void reset() override;
-    QVector<unsigned char> colorMap(int* clipped = NULL) const override;
+    ColorMap::Generator generator(int& n) const override;
     QString reference() const override;
     void parameters(int& n, float& saturation_range, float& lightness, float& saturation, float& hue, float& divergence) const;
 };
@@ -356,7 +393,7 @@ public:
     ~ColorMapPUQualitativeHueWidget();
 
     void reset() override;
-    QVector<unsigned char> colorMap(int* clipped = NULL) const override;
+    ColorMap::Generator generator(int& n) const override;
     QString reference() const override;
     void parameters(int& n, float& hue, float& divergence, float& lightness, float& saturation) const;
 };
@@ -379,7 +416,7 @@ public:
     ~ColorMapCubeHelixWidget();
 
     void reset() override;
-    QVector<unsigned char> colorMap(int* clipped = NULL) const override;
+    ColorMap::Generator generator(int& n) const override;
     QString reference() const override;
     void parameters(int& n, float& hue, float& rotations,
             float& saturation, float& gamma) const;
@@ -405,7 +442,7 @@ public:
     ~ColorMapMorelandWidget();
 
     void reset() override;
-    QVector<unsigned char> colorMap(int* clipped = NULL) const override;
+    ColorMap::Generator generator(int& n) const override;
     QString reference() const override;
     void parameters(int& n,
             unsigned char& r0, unsigned char& g0, unsigned char& b0,
@@ -427,7 +464,7 @@ public:
     ~ColorMapMcNamesWidget();
 
     void reset() override;
-    QVector<unsigned char> colorMap(int* clipped = NULL) const override;
+    ColorMap::Generator generator(int& n) const override;
     QString reference() const override;
     void parameters(int& n, float& p) const;
 };
@@ -22,49 +22,655 @@
  * SOFTWARE.
  */
 
+#include <vector>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cmath>
+
 #include "export.hpp"
+#include "colormap.hpp"
 
 namespace ColorMap {
 
-std::string ToCSV(int n, const unsigned char* srgb_colormap)
+// Formats output into a fixed-size buffer and passes it on either to a file
+// or to a string whenever the buffer is full.
+class writer {
+private:
+    char _buf[65536];
+    size_t _len;
+    FILE* _file;
+    std::string* _string;
+    bool _ok;
+
+    void write(const char* p, size_t n)
+    {
+        if (_file) {
+            if (_ok && fwrite(p, 1, n, _file) != n)
+                _ok = false;
+        } else {
+            _string->append(p, n);
+        }
+    }
+
+    void reserve(size_t n)
+    {
+        if (_len + n > sizeof(_buf))
+            flush();
+    }
+
+public:
+    writer(FILE* f) : _len(0), _file(f), _string(NULL), _ok(true) {}
+    writer(std::string* s) : _len(0), _file(NULL), _string(s), _ok(true) {}
+
+    bool flush()
+    {
+        write(_buf, _len);
+        _len = 0;
+        return _ok;
+    }
+
+    void put(char c)
+    {
+        reserve(1);
+        _buf[_len++] = c;
+    }
+
+    void put(const char* s)
+    {
+        size_t n = std::strlen(s);
+        reserve(n);
+        if (n > sizeof(_buf)) {
+            write(s, n);
+        } else {
+            std::memcpy(_buf + _len, s, n);
+            _len += n;
+        }
+    }
+
+    void put(int x)
+    {
+        reserve(16);
+        _len = std::to_chars(_buf + _len, _buf + sizeof(_buf), x).ptr - _buf;
+    }
+
+    // Same format as std::to_string(x), i.e. %f
+    void put(float x)
+    {
+        reserve(64);
+        std::to_chars_result r = std::to_chars(_buf + _len, _buf + sizeof(_buf), x, std::chars_format::fixed, 6);
+        if (r.ec == std::errc())
+            _len = r.ptr - _buf;
+        else
+            put(std::to_string(x).c_str());
+    }
+};
+
+static void csv(writer& w, int n, const unsigned char* srgb_colormap)
 {
-    std::string s;
     for (int i = 0; i < n; i++) {
-        s +=  std::to_string(srgb_colormap[3 * i + 0]) + ", "
-            + std::to_string(srgb_colormap[3 * i + 1]) + ", "
-            + std::to_string(srgb_colormap[3 * i + 2]) + '\n';
+        w.put(int(srgb_colormap[3 * i + 0]));
+        w.put(", ");
+        w.put(int(srgb_colormap[3 * i + 1]));
+        w.put(", ");
+        w.put(int(srgb_colormap[3 * i + 2]));
+        w.put('\n');
     }
-    return s;
 }
 
-std::string ToJSON(int n, const unsigned char* srgb_colormap)
+static void json(writer& w, int n, const unsigned char* srgb_colormap)
 {
-    std::string s =
+    w.put(
         "[\n"
         "{\n"
         "\"ColorSpace\" : \"RGB\",\n"
         "\"Name\" : \"GenColorMapGenerated\",\n"
         "\"NanColor\" : [ -1, -1, -1 ],\n"
-        "\"RGBPoints\" : [\n";
+        "\"RGBPoints\" : [\n");
+    for (int i = 0; i < n; i++) {
+        w.put(i / float(n - 1));
+        w.put(", ");
+        w.put(srgb_colormap[3 * i + 0] / 255.0f);
+        w.put(", ");
+        w.put(srgb_colormap[3 * i + 1] / 255.0f);
+        w.put(", ");
+        w.put(srgb_colormap[3 * i + 2] / 255.0f);
+        w.put(i == n - 1 ? "\n" : ",\n");
+    }
+    w.put("]\n}\n]\n");
+}
+
+static void ppm(writer& w, int n, const unsigned char* srgb_colormap)
+{
+    w.put("P3\n"); // magic number for plain PPM
+    w.put(n);
+    w.put(" 1\n"); // width and height
+    w.put("255\n"); // max val
     for (int i = 0; i < n; i++) {
-        s +=  std::to_string(i / float(n - 1)) + ", "
-            + std::to_string(srgb_colormap[3 * i + 0] / 255.0f) + ", "
-            + std::to_string(srgb_colormap[3 * i + 1] / 255.0f) + ", "
-            + std::to_string(srgb_colormap[3 * i + 2] / 255.0f) + (i == n - 1 ? "\n" : ",\n");
+        w.put(int(srgb_colormap[3 * i + 0]));
+        w.put(' ');
+        w.put(int(srgb_colormap[3 * i + 1]));
+        w.put(' ');
+        w.put(int(srgb_colormap[3 * i + 2]));
+        w.put('\n');
     }
-    s += "]\n}\n]\n";
+}
+
+// The reserved sizes are upper bounds for the output, so that the string is
+// allocated only once.
+
+std::string ToCSV(int n, const unsigned char* srgb_colormap)
+{
+    std::string s;
+    s.reserve(size_t(n) * 14);
+    writer w(&s);
+    csv(w, n, srgb_colormap);
+    w.flush();
+    return s;
+}
+
+std::string ToJSON(int n, const unsigned char* srgb_colormap)
+{
+    std::string s;
+    s.reserve(128 + size_t(n) * 40);
+    writer w(&s);
+    json(w, n, srgb_colormap);
+    w.flush();
     return s;
 }
 
 std::string ToPPM(int n, const unsigned char* srgb_colormap)
 {
-    std::string s = "P3\n"; // magic number for plain PPM
-    s += std::to_string(n) + " 1\n"; // width and height
-    s += "255\n"; // max val
+    std::string s;
+    s.reserve(32 + size_t(n) * 12);
+    writer w(&s);
+    ppm(w, n, srgb_colormap);
+    w.flush();
+    return s;
+}
+
+bool WriteCSV(FILE* f, int n, const unsigned char* srgb_colormap)
+{
+    writer w(f);
+    csv(w, n, srgb_colormap);
+    return w.flush();
+}
+
+bool WriteJSON(FILE* f, int n, const unsigned char* srgb_colormap)
+{
+    writer w(f);
+    json(w, n, srgb_colormap);
+    return w.flush();
+}
+
+bool WritePPM(FILE* f, int n, const unsigned char* srgb_colormap)
+{
+    writer w(f);
+    ppm(w, n, srgb_colormap);
+    return w.flush();
+}
+
+
+bool WritePPMBinary(FILE* f, int n, const unsigned char* srgb_colormap)
+{
+    return WritePPMBinary(f, n, 1, srgb_colormap);
+}
+
+bool WritePPMBinary(FILE* f, int width, int height, const unsigned char* srgb_image)
+{
+    std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    size_t pixels = size_t(width) * height;
+    return fwrite(header.data(), 1, header.size(), f) == header.size()
+        && fwrite(srgb_image, 3, pixels, f) == pixels;
+}
+
+/* PNG output. This writes a single IDAT chunk that contains the image data in
+ * uncompressed deflate blocks, so that we do not need zlib. */
+
+class crc32_table {
+public:
+    unsigned int t[256];
+
+    crc32_table()
+    {
+        for (unsigned int i = 0; i < 256; i++) {
+            unsigned int c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1);
+            t[i] = c;
+        }
+    }
+};
+
+static unsigned int crc32(const unsigned char* p, size_t n)
+{
+    static const crc32_table table;
+    unsigned int crc = 0xffffffffu;
+    for (size_t i = 0; i < n; i++)
+        crc = table.t[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void put_u32_be(std::vector<unsigned char>& v, unsigned int x)
+{
+    v.push_back(x >> 24);
+    v.push_back((x >> 16) & 0xff);
+    v.push_back((x >> 8) & 0xff);
+    v.push_back(x & 0xff);
+}
+
+static bool write_png_chunk(FILE* f, const char* type, const std::vector<unsigned char>& data)
+{
+    std::vector<unsigned char> chunk;
+    chunk.reserve(data.size() + 12);
+    put_u32_be(chunk, data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    put_u32_be(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+    return fwrite(chunk.data(), 1, chunk.size(), f) == chunk.size();
+}
+
+bool WritePNG(FILE* f, int n, const unsigned char* srgb_colormap)
+{
+    return WritePNG(f, n, 1, srgb_colormap);
+}
+
+bool WritePNG(FILE* f, int width, int height, const unsigned char* srgb_image)
+{
+    static const unsigned char signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+
+    std::vector<unsigned char> ihdr;
+    put_u32_be(ihdr, width);
+    put_u32_be(ihdr, height);
+    ihdr.push_back(8);          // bit depth
+    ihdr.push_back(2);          // color type: RGB
+    ihdr.push_back(0);          // compression method
+    ihdr.push_back(0);          // filter method
+    ihdr.push_back(0);          // interlace method
+
+    // The uncompressed image data consists of the rows, each with the
+    // filter type (none) followed by the RGB values
+    size_t row_size = 3 * size_t(width);
+    std::vector<unsigned char> raw((1 + row_size) * height);
+    for (int y = 0; y < height; y++) {
+        raw[y * (1 + row_size)] = 0;
+        std::memcpy(raw.data() + y * (1 + row_size) + 1, srgb_image + y * row_size, row_size);
+    }
+
+    // zlib stream with stored deflate blocks of at most 65535 bytes each
+    std::vector<unsigned char> idat;
+    idat.reserve(raw.size() + 5 * (raw.size() / 65535 + 1) + 6);
+    idat.push_back(0x78);
+    idat.push_back(0x01);
+    size_t pos = 0;
+    do {
+        size_t len = std::min(raw.size() - pos, size_t(65535));
+        bool last = (pos + len == raw.size());
+        idat.push_back(last ? 1 : 0);
+        idat.push_back(len & 0xff);
+        idat.push_back(len >> 8);
+        idat.push_back(~len & 0xff);
+        idat.push_back((~len >> 8) & 0xff);
+        idat.insert(idat.end(), raw.begin() + pos, raw.begin() + pos + len);
+        pos += len;
+    } while (pos < raw.size());
+    unsigned int a = 1, b = 0; // Adler-32 checksum
+    for (size_t i = 0; i < raw.size(); i++) {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    put_u32_be(idat, (b << 16) | a);
+
+    return fwrite(signature, 1, sizeof(signature), f) == sizeof(signature)
+        && write_png_chunk(f, "IHDR", ihdr)
+        && write_png_chunk(f, "IDAT", idat)
+        && write_png_chunk(f, "IEND", std::vector<unsigned char>());
+}
+
+/* Packed palettes. The packed values are written byte by byte, so that the
+ * output does not depend on the byte order of the host. */
+
+void PackRGBA8(int n, const unsigned char* srgb_colormap, unsigned int* rgba8)
+{
+    for (int i = 0; i < n; i++) {
+        const unsigned char* c = srgb_colormap + 3 * i;
+        rgba8[i] = c[0] | c[1] << 8 | c[2] << 16 | 0xffu << 24;
+    }
+}
+
+void PackRGB565(int n, const unsigned char* srgb_colormap, unsigned short* rgb565)
+{
+    for (int i = 0; i < n; i++) {
+        const unsigned char* c = srgb_colormap + 3 * i;
+        unsigned int r = (c[0] * 31 + 127) / 255;
+        unsigned int g = (c[1] * 63 + 127) / 255;
+        unsigned int b = (c[2] * 31 + 127) / 255;
+        rgb565[i] = r << 11 | g << 5 | b;
+    }
+}
+
+bool WriteRGBA8(FILE* f, int n, const unsigned char* srgb_colormap)
+{
+    std::vector<unsigned int> packed(n);
+    PackRGBA8(n, srgb_colormap, packed.data());
+    std::vector<unsigned char> data(4 * size_t(n));
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < 4; j++)
+            data[4 * i + j] = (packed[i] >> (8 * j)) & 0xff;
+    return fwrite(data.data(), 1, data.size(), f) == data.size();
+}
+
+bool WriteRGB565(FILE* f, int n, const unsigned char* srgb_colormap)
+{
+    std::vector<unsigned short> packed(n);
+    PackRGB565(n, srgb_colormap, packed.data());
+    std::vector<unsigned char> data(2 * size_t(n));
     for (int i = 0; i < n; i++) {
-        s +=  std::to_string(srgb_colormap[3 * i + 0]) + ' '
-            + std::to_string(srgb_colormap[3 * i + 1]) + ' '
-            + std::to_string(srgb_colormap[3 * i + 2]) + '\n';
+        data[2 * i + 0] = packed[i] & 0xff;
+        data[2 * i + 1] = packed[i] >> 8;
+    }
+    return fwrite(data.data(), 1, data.size(), f) == data.size();
+}
+
+/* KTX2 and DDS output. Both write an uncompressed 1D texture with a single
+ * mip level. */
+
+static void put_u32_le(std::vector<unsigned char>& v, unsigned int x)
+{
+    v.push_back(x & 0xff);
+    v.push_back((x >> 8) & 0xff);
+    v.push_back((x >> 16) & 0xff);
+    v.push_back(x >> 24);
+}
+
+static void put_u64_le(std::vector<unsigned char>& v, unsigned long long x)
+{
+    put_u32_le(v, x & 0xffffffffu);
+    put_u32_le(v, x >> 32);
+}
+
+static bool write_rgba8(FILE* f, const std::vector<unsigned char>& header, int n, const unsigned char* srgb_colormap)
+{
+    std::vector<unsigned char> data(header);
+    data.reserve(header.size() + 4 * size_t(n));
+    for (int i = 0; i < n; i++) {
+        data.insert(data.end(), srgb_colormap + 3 * i, srgb_colormap + 3 * i + 3);
+        data.push_back(255);
+    }
+    return fwrite(data.data(), 1, data.size(), f) == data.size();
+}
+
+bool WriteKTX2(FILE* f, int n, const unsigned char* srgb_colormap)
+{
+    static const unsigned char identifier[12] = { 0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n' };
+    const unsigned int header_size = 12 + 9 * 4 + 4 * 4 + 2 * 8 + 3 * 8;
+    const unsigned int dfd_size = 4 + 24 + 4 * 16;
+    const unsigned long long data_size = 4 * (unsigned long long)n;
+
+    std::vector<unsigned char> h(identifier, identifier + sizeof(identifier));
+    put_u32_le(h, 43);          // vkFormat: VK_FORMAT_R8G8B8A8_SRGB
+    put_u32_le(h, 1);           // typeSize
+    put_u32_le(h, n);           // pixelWidth
+    put_u32_le(h, 0);           // pixelHeight: 0 for 1D textures
+    put_u32_le(h, 0);           // pixelDepth
+    put_u32_le(h, 0);           // layerCount: not an array
+    put_u32_le(h, 1);           // faceCount
+    put_u32_le(h, 1);           // levelCount
+    put_u32_le(h, 0);           // supercompressionScheme: none
+    put_u32_le(h, header_size); // dfdByteOffset
+    put_u32_le(h, dfd_size);    // dfdByteLength
+    put_u32_le(h, 0);           // kvdByteOffset: no key/value data
+    put_u32_le(h, 0);           // kvdByteLength
+    put_u64_le(h, 0);           // sgdByteOffset: no supercompression data
+    put_u64_le(h, 0);           // sgdByteLength
+    put_u64_le(h, header_size + dfd_size); // level 0: byteOffset
+    put_u64_le(h, data_size);   // byteLength
+    put_u64_le(h, data_size);   // uncompressedByteLength
+
+    // Data format descriptor: one basic descriptor block with four 8 bit
+    // samples for R, G, B (sRGB transfer) and A (linear)
+    put_u32_le(h, dfd_size);
+    put_u32_le(h, 0);                   // vendorId and descriptorType: Khronos basic
+    put_u32_le(h, 2 | (24 + 4 * 16) << 16); // versionNumber and descriptorBlockSize
+    put_u32_le(h, 1 | 1 << 8 | 2 << 16); // colorModel RGBSDA, primaries BT709, transfer sRGB, straight alpha
+    put_u32_le(h, 0);                   // texelBlockDimension: 1x1x1x1
+    put_u32_le(h, 4);                   // bytesPlane0
+    put_u32_le(h, 0);                   // bytesPlane4-7
+    static const unsigned int channels[4] = { 0, 1, 2, 15 | 0x10 };
+    for (int c = 0; c < 4; c++) {
+        put_u32_le(h, 8 * c | 7 << 16 | channels[c] << 24); // bitOffset, bitLength - 1, channelType
+        put_u32_le(h, 0);               // samplePosition
+        put_u32_le(h, 0);               // sampleLower
+        put_u32_le(h, 255);             // sampleUpper
+    }
+
+    return write_rgba8(f, h, n, srgb_colormap);
+}
+
+bool WriteDDS(FILE* f, int n, const unsigned char* srgb_colormap)
+{
+    std::vector<unsigned char> h = { 'D', 'D', 'S', ' ' };
+    put_u32_le(h, 124);         // dwSize
+    put_u32_le(h, 0x100f);      // dwFlags: CAPS, HEIGHT, WIDTH, PITCH, PIXELFORMAT
+    put_u32_le(h, 1);           // dwHeight
+    put_u32_le(h, n);           // dwWidth
+    put_u32_le(h, 4 * n);       // dwPitchOrLinearSize
+    put_u32_le(h, 0);           // dwDepth
+    put_u32_le(h, 1);           // dwMipMapCount
+    for (int i = 0; i < 11; i++)
+        put_u32_le(h, 0);       // dwReserved1
+    put_u32_le(h, 32);          // ddspf.dwSize
+    put_u32_le(h, 0x4);         // ddspf.dwFlags: FOURCC
+    h.insert(h.end(), { 'D', 'X', '1', '0' }); // ddspf.dwFourCC: DX10 header follows
+    for (int i = 0; i < 5; i++)
+        put_u32_le(h, 0);       // ddspf bit count and masks
+    put_u32_le(h, 0x1000);      // dwCaps: TEXTURE
+    for (int i = 0; i < 4; i++)
+        put_u32_le(h, 0);       // dwCaps2-4, dwReserved2
+    put_u32_le(h, 29);          // dxgiFormat: DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+    put_u32_le(h, 2);           // resourceDimension: TEXTURE1D
+    put_u32_le(h, 0);           // miscFlag
+    put_u32_le(h, 1);           // arraySize
+    put_u32_le(h, 1);           // miscFlags2: straight alpha
+    return write_rgba8(f, h, n, srgb_colormap);
+}
+
+/* Shader output. Each interval gets a cubic polynomial per channel in the
+ * local coordinate u in [0,1), fitted to the colors on the interval by least
+ * squares. A fit is accepted if it reproduces all of them within the Delta E
+ * limit. The number of intervals is searched by doubling and then bisection;
+ * n intervals always fit since each then contains a single color. */
+
+static const int shader_degree = 3;
+
+// The colors on interval s of k lie in [first, end)
+static int shader_interval_first(int n, int k, int s)
+{
+    return (2 * (long long)s * n + k - 1) / (2 * (long long)k);
+}
+
+static float shader_poly(const float* coef, int channel, float u)
+{
+    float c = coef[3 * shader_degree + channel];
+    for (int p = shader_degree - 1; p >= 0; p--)
+        c = coef[3 * p + channel] + u * c;
+    return std::min(std::max(c, 0.0f), 1.0f);
+}
+
+// Fit the polynomial of interval s of k and store its 3 * (shader_degree + 1)
+// coefficients, ordered by power. Return the largest Delta E error.
+static float shader_fit_interval(int n, const unsigned char* srgb_colormap, int k, int s, float* coef)
+{
+    int first = shader_interval_first(n, k, s);
+    int end = (s == k - 1 ? n : shader_interval_first(n, k, s + 1));
+    int degree = std::min(shader_degree, end - first - 1);
+    int m = degree + 1;
+
+    // Normal equations, solved by Gaussian elimination with partial pivoting
+    double a[shader_degree + 1][shader_degree + 1] = {};
+    double b[shader_degree + 1][3] = {};
+    for (int i = first; i < end; i++) {
+        double u = (i + 0.5) * k / n - s;
+        double up[2 * shader_degree + 1];
+        up[0] = 1.0;
+        for (int p = 1; p <= 2 * degree; p++)
+            up[p] = up[p - 1] * u;
+        for (int p = 0; p < m; p++) {
+            for (int q = 0; q < m; q++)
+                a[p][q] += up[p + q];
+            for (int c = 0; c < 3; c++)
+                b[p][c] += up[p] * (srgb_colormap[3 * i + c] / 255.0);
+        }
+    }
+    for (int p = 0; p < m; p++) {
+        int pivot = p;
+        for (int q = p + 1; q < m; q++)
+            if (std::abs(a[q][p]) > std::abs(a[pivot][p]))
+                pivot = q;
+        for (int q = 0; q < m; q++)
+            std::swap(a[p][q], a[pivot][q]);
+        for (int c = 0; c < 3; c++)
+            std::swap(b[p][c], b[pivot][c]);
+        for (int q = p + 1; q < m; q++) {
+            double f = a[q][p] / a[p][p];
+            for (int r = p; r < m; r++)
+                a[q][r] -= f * a[p][r];
+            for (int c = 0; c < 3; c++)
+                b[q][c] -= f * b[p][c];
+        }
+    }
+    for (int p = shader_degree; p >= 0; p--) {
+        for (int c = 0; c < 3; c++) {
+            double x = 0.0;
+            if (p < m) {
+                x = b[p][c];
+                for (int q = p + 1; q < m; q++)
+                    x -= a[p][q] * coef[3 * q + c];
+                x /= a[p][p];
+            }
+            coef[3 * p + c] = x;
+        }
+    }
+
+    float max_error = 0.0f;
+    for (int i = first; i < end; i++) {
+        float u = (i + 0.5) * k / n - s;
+        float fitted[3], color[3];
+        for (int c = 0; c < 3; c++) {
+            fitted[c] = shader_poly(coef, c, u);
+            color[c] = srgb_colormap[3 * i + c] / 255.0f;
+        }
+        max_error = std::max(max_error, DeltaE2000(color, fitted));
+    }
+    return max_error;
+}
+
+// Fit all k intervals. Stop at the first interval that exceeds the limit and
+// return false in that case.
+static bool shader_fit(int n, const unsigned char* srgb_colormap, int k, float max_delta_e,
+        std::vector<float>& coefficients, float* max_error)
+{
+    coefficients.resize(3 * (shader_degree + 1) * size_t(k));
+    *max_error = 0.0f;
+    for (int s = 0; s < k; s++) {
+        float e = shader_fit_interval(n, srgb_colormap, k, s, coefficients.data() + 3 * (shader_degree + 1) * s);
+        *max_error = std::max(*max_error, e);
+        if (e > max_delta_e && k < n)
+            return false;
+    }
+    return true;
+}
+
+// Print a float so that it is read back exactly and is a float literal in
+// all supported languages
+static std::string shader_float(float x)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.9g", x);
+    std::string s = buf;
+    if (s.find_first_of(".e") == std::string::npos)
+        s += ".0";
+    return s;
+}
+
+std::string ToShader(int n, const unsigned char* srgb_colormap, ShaderLanguage language,
+        float max_delta_e, const char* name)
+{
+    std::vector<float> coefficients;
+    float max_error;
+    int lo = 0; // the largest number of intervals known not to fit
+    int k = 1;
+    while (!shader_fit(n, srgb_colormap, k, max_delta_e, coefficients, &max_error)) {
+        lo = k;
+        k = std::min(2 * k, n);
+    }
+    if (k - lo > 1) {
+        while (k - lo > 1) {
+            int mid = lo + (k - lo) / 2;
+            if (shader_fit(n, srgb_colormap, mid, max_delta_e, coefficients, &max_error))
+                k = mid;
+            else
+                lo = mid;
+        }
+        shader_fit(n, srgb_colormap, k, max_delta_e, coefficients, &max_error);
+    }
+
+    const char* vec3 = (language == GLSL ? "vec3" : language == HLSL ? "float3" : "vec3<f32>");
+    std::string array = std::string(name) + "_coefficients";
+    std::string size = std::to_string(4 * k);
+    std::string ks = std::to_string(k);
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.2f, limit %.2f", max_error, max_delta_e);
+
+    std::string s;
+    s += "// Color map with " + std::to_string(n) + " colors, approximated by cubic polynomials\n"
+        "// on " + ks + " equally sized interval" + (k > 1 ? "s" : "") + " of [0,1]. Largest CIEDE2000 error\n"
+        "// at the colors of the map: " + buf + ".\n"
+        "// The result is sRGB, not linear RGB.\n";
+    if (language == GLSL)
+        s += "const vec3 " + array + "[" + size + "] = vec3[" + size + "](\n";
+    else if (language == HLSL)
+        s += "static const float3 " + array + "[" + size + "] = {\n";
+    else
+        s += "const " + array + " = array<vec3<f32>, " + size + ">(\n";
+    for (int j = 0; j < 4 * k; j++) {
+        const float* c = coefficients.data() + 3 * j;
+        s += std::string("    ") + vec3 + "(" + shader_float(c[0]) + ", " + shader_float(c[1]) + ", "
+            + shader_float(c[2]) + ")" + (j < 4 * k - 1 || language == WGSL ? ",\n" : "\n");
+    }
+    s += (language == HLSL ? "};\n\n" : ");\n\n");
+
+    std::string poly = array + "[j] + u * (" + array + "[j + 1] + u * ("
+        + array + "[j + 2] + u * " + array + "[j + 3]))";
+    if (language == GLSL) {
+        s += "vec3 " + std::string(name) + "(float t)\n"
+            "{\n"
+            "    float s = clamp(t, 0.0, 1.0) * " + ks + ".0;\n"
+            "    int i = min(int(s), " + std::to_string(k - 1) + ");\n"
+            "    float u = s - float(i);\n"
+            "    int j = 4 * i;\n"
+            "    vec3 c = " + poly + ";\n"
+            "    return clamp(c, 0.0, 1.0);\n"
+            "}\n";
+    } else if (language == HLSL) {
+        s += "float3 " + std::string(name) + "(float t)\n"
+            "{\n"
+            "    float s = saturate(t) * " + ks + ".0;\n"
+            "    int i = min(int(s), " + std::to_string(k - 1) + ");\n"
+            "    float u = s - float(i);\n"
+            "    int j = 4 * i;\n"
+            "    float3 c = " + poly + ";\n"
+            "    return saturate(c);\n"
+            "}\n";
+    } else {
+        s += "fn " + std::string(name) + "(t: f32) -> vec3<f32> {\n"
+            "    let s = clamp(t, 0.0, 1.0) * " + ks + ".0;\n"
+            "    let i = min(u32(s), " + std::to_string(k - 1) + "u);\n"
+            "    let u = s - f32(i);\n"
+            "    let j = 4u * i;\n"
+            "    let c = " + poly + ";\n"
+            "    return clamp(c, vec3<f32>(0.0), vec3<f32>(1.0));\n"
+            "}\n";
     }
     return s;
 }
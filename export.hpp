@@ -26,6 +26,7 @@
 #define COLORMAP_EXPORT_HPP
 
 #include <string>
+#include <cstdio>
 
 namespace ColorMap {
 
@@ -38,6 +39,65 @@ std::string ToJSON(int n, const unsigned char* srgb_colormap);
 // Convert a color map with n sRGB triplets to PPM format
 std::string ToPPM(int n, const unsigned char* srgb_colormap);
 
+// Write a color map with n sRGB triplets to a file in CSV, JSON, or PPM format.
+// The output is the same as for the functions above, but it is written in
+// small pieces instead of being built in memory first, which matters for large
+// color maps. Return false if writing failed.
+bool WriteCSV(FILE* f, int n, const unsigned char* srgb_colormap);
+bool WriteJSON(FILE* f, int n, const unsigned char* srgb_colormap);
+bool WritePPM(FILE* f, int n, const unsigned char* srgb_colormap);
+
+// Write a color map with n sRGB triplets to a file as a binary PPM (P6) image
+// or as a PNG image, each of size n x 1. The PNG writer does not compress the
+// image data. The file must be opened in binary mode. Return false if writing
+// failed.
+bool WritePPMBinary(FILE* f, int n, const unsigned char* srgb_colormap);
+bool WritePNG(FILE* f, int n, const unsigned char* srgb_colormap);
+
+// Write an image of width x height sRGB triplets, stored row by row, in the
+// same way, e.g. several color maps with width colors each.
+bool WritePPMBinary(FILE* f, int width, int height, const unsigned char* srgb_image);
+bool WritePNG(FILE* f, int width, int height, const unsigned char* srgb_image);
+
+// Pack a color map with n sRGB triplets into n GPU texel values for indexed
+// lookups, e.g. the palette of a label image: 32 bit RGBA8 values with R in
+// the lowest byte and opaque alpha (R8G8B8A8 formats), or 16 bit RGB565
+// values with R in the highest 5 bits (R5G6B5 / B5G6R5 formats). The RGB565
+// values are rounded to the nearest representable color, so close colors of
+// large maps can become equal.
+void PackRGBA8(int n, const unsigned char* srgb_colormap, unsigned int* rgba8);
+void PackRGB565(int n, const unsigned char* srgb_colormap, unsigned short* rgb565);
+
+// Write the packed values of a color map with n sRGB triplets to a file in
+// little endian byte order, without a header. The file must be opened in
+// binary mode. Return false if writing failed.
+bool WriteRGBA8(FILE* f, int n, const unsigned char* srgb_colormap);
+bool WriteRGB565(FILE* f, int n, const unsigned char* srgb_colormap);
+
+// Write a color map with n sRGB triplets to a file as a 1D texture of width n
+// in KTX2 or DDS format, so that GPU programs can upload it without parsing.
+// The texels are in RGBA8 sRGB format with opaque alpha. The file must be
+// opened in binary mode. Return false if writing failed.
+bool WriteKTX2(FILE* f, int n, const unsigned char* srgb_colormap);
+bool WriteDDS(FILE* f, int n, const unsigned char* srgb_colormap);
+
+// Shading languages for ToShader
+enum ShaderLanguage {
+    GLSL,
+    HLSL,
+    WGSL
+};
+
+// Convert a color map with n sRGB triplets to a shader function with the given
+// name that maps t in [0,1] to an sRGB color, with no texture fetch. The
+// function evaluates a cubic polynomial on one of k equally sized intervals of
+// [0,1], where k is the smallest number of intervals found for which each color
+// of the map is reproduced with a CIEDE2000 error of at most max_delta_e. As
+// for a 1D texture, color i is placed at t = (i + 0.5) / n. The interval is
+// selected by arithmetic, so the function has no branches.
+std::string ToShader(int n, const unsigned char* srgb_colormap, ShaderLanguage language,
+        float max_delta_e = 1.0f, const char* name = "colormap");
+
 }
 
 #endif
@@ -0,0 +1,415 @@
+/*
+ * Copyright (C) 2024
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <vector>
+#include <string>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include "gencolormap.h"
+#include "colormap.hpp"
+#include "export.hpp"
+#include "cache.hpp"
+
+static_assert(GENCOLORMAP_SRGB8 == int(ColorMap::SRGB8)
+        && GENCOLORMAP_SRGB16 == int(ColorMap::SRGB16)
+        && GENCOLORMAP_SRGB_HALF == int(ColorMap::SRGBHalf)
+        && GENCOLORMAP_SRGB_FLOAT == int(ColorMap::SRGBFloat)
+        && GENCOLORMAP_LINEAR_RGB16 == int(ColorMap::LinearRGB16)
+        && GENCOLORMAP_LINEAR_RGB_HALF == int(ColorMap::LinearRGBHalf)
+        && GENCOLORMAP_LINEAR_RGB_FLOAT == int(ColorMap::LinearRGBFloat),
+        "C output formats must match ColorMap::Format");
+
+struct gencolormap_generator {
+    ColorMap::Generator generator;
+};
+
+// Get parameter i, or the default value if it was not given
+static float param(int count, const float* params, int i, float default_value)
+{
+    return (i < count ? params[i] : default_value);
+}
+
+static unsigned char param_uchar(int count, const float* params, int i, unsigned char default_value)
+{
+    float v = param(count, params, i, default_value);
+    return (v >= 255.0f ? 255 : v > 0.0f ? static_cast<unsigned char>(v + 0.5f) : 0);
+}
+
+static bool create_generator(int type, int c, const float* p, gencolormap_generator** g)
+{
+    using namespace ColorMap;
+    switch (type) {
+    case GENCOLORMAP_BREWER_SEQUENTIAL:
+        *g = new gencolormap_generator { Generator::BrewerSequential(
+                    param(c, p, 0, BrewerSequentialDefaultHue),
+                    param(c, p, 1, BrewerSequentialDefaultContrast),
+                    param(c, p, 2, BrewerSequentialDefaultSaturation),
+                    param(c, p, 3, BrewerSequentialDefaultBrightness),
+                    param(c, p, 4, BrewerSequentialDefaultWarmth)) };
+        break;
+    case GENCOLORMAP_BREWER_DIVERGING:
+        *g = new gencolormap_generator { Generator::BrewerDiverging(
+                    param(c, p, 0, BrewerDivergingDefaultHue),
+                    param(c, p, 1, BrewerDivergingDefaultDivergence),
+                    param(c, p, 2, BrewerDivergingDefaultContrast),
+                    param(c, p, 3, BrewerDivergingDefaultSaturation),
+                    param(c, p, 4, BrewerDivergingDefaultBrightness),
+                    param(c, p, 5, BrewerDivergingDefaultWarmth)) };
+        break;
+    case GENCOLORMAP_BREWER_QUALITATIVE:
+        *g = new gencolormap_generator { Generator::BrewerQualitative(
+                    param(c, p, 0, BrewerQualitativeDefaultHue),
+                    param(c, p, 1, BrewerQualitativeDefaultDivergence),
+                    param(c, p, 2, BrewerQualitativeDefaultContrast),
+                    param(c, p, 3, BrewerQualitativeDefaultSaturation),
+                    param(c, p, 4, BrewerQualitativeDefaultBrightness),
+                    param(c, p, 5, BrewerQualitativeDefaultStableOrder) != 0.0f) };
+        break;
+    case GENCOLORMAP_PU_SEQUENTIAL_LIGHTNESS:
+        *g = new gencolormap_generator { Generator::PUSequentialLightness(
+                    param(c, p, 0, PUSequentialLightnessDefaultLightnessRange),
+                    param(c, p, 1, PUSequentialLightnessDefaultSaturationRange),
+                    param(c, p, 2, PUSequentialLightnessDefaultSaturation),
+                    param(c, p, 3, PUSequentialLightnessDefaultHue)) };
+        break;
+    case GENCOLORMAP_PU_SEQUENTIAL_SATURATION:
+        *g = new gencolormap_generator { Generator::PUSequentialSaturation(
+                    param(c, p, 0, PUSequentialSaturationDefaultSaturationRange),
+                    param(c, p, 1, PUSequentialSaturationDefaultLightness),
+                    param(c, p, 2, PUSequentialSaturationDefaultSaturation),
+                    param(c, p, 3, PUSequentialSaturationDefaultHue)) };
+        break;
+    case GENCOLORMAP_PU_SEQUENTIAL_RAINBOW:
+        *g = new gencolormap_generator { Generator::PUSequentialRainbow(
+                    param(c, p, 0, PUSequentialRainbowDefaultLightnessRange),
+                    param(c, p, 1, PUSequentialRainbowDefaultSaturationRange),
+                    param(c, p, 2, PUSequentialRainbowDefaultHue),
+                    param(c, p, 3, PUSequentialRainbowDefaultRotations),
+                    param(c, p, 4, PUSequentialRainbowDefaultSaturation)) };
+        break;
+    case GENCOLORMAP_PU_SEQUENTIAL_BLACK_BODY:
+        *g = new gencolormap_generator { Generator::PUSequentialBlackBody(
+                    param(c, p, 0, PUSequentialBlackBodyDefaultTemperature),
+                    param(c, p, 1, PUSequentialBlackBodyDefaultTemperatureRange),
+                    param(c, p, 2, PUSequentialBlackBodyDefaultLightnessRange),
+                    param(c, p, 3, PUSequentialBlackBodyDefaultSaturationRange),
+                    param(c, p, 4, PUSequentialBlackBodyDefaultSaturation)) };
+        break;
+    case GENCOLORMAP_PU_SEQUENTIAL_MULTI_HUE:
+        {
+            int hues = PUSequentialMultiHueDefaultHues;
+            const float* hue_values = PUSequentialMultiHueDefaultHueValues;
+            const float* hue_positions = PUSequentialMultiHueDefaultHuePositions;
+            if (c > 3) {
+                // Check the float before converting it, so that NaN and huge
+                // values are rejected instead of causing undefined behavior
+                if (!(p[3] >= 1.0f && p[3] <= (c - 4) / 2 && p[3] == std::floor(p[3])))
+                    return false;
+                hues = p[3];
+                if (c != 4 + 2 * hues)
+                    return false;
+                hue_values = p + 4;
+                hue_positions = p + 4 + hues;
+            }
+            *g = new gencolormap_generator { Generator::PUSequentialMultiHue(
+                        param(c, p, 0, PUSequentialMultiHueDefaultLightnessRange),
+                        param(c, p, 1, PUSequentialMultiHueDefaultSaturationRange),
+                        param(c, p, 2, PUSequentialMultiHueDefaultSaturation),
+                        hues, hue_values, hue_positions) };
+        }
+        break;
+    case GENCOLORMAP_PU_DIVERGING_LIGHTNESS:
+        *g = new gencolormap_generator { Generator::PUDivergingLightness(
+                    param(c, p, 0, PUDivergingLightnessDefaultLightnessRange),
+                    param(c, p, 1, PUDivergingLightnessDefaultSaturationRange),
+                    param(c, p, 2, PUDivergingLightnessDefaultSaturation),
+                    param(c, p, 3, PUDivergingLightnessDefaultHue),
+                    param(c, p, 4, PUDivergingLightnessDefaultDivergence)) };
+        break;
+    case GENCOLORMAP_PU_DIVERGING_SATURATION:
+        *g = new gencolormap_generator { Generator::PUDivergingSaturation(
+                    param(c, p, 0, PUDivergingSaturationDefaultSaturationRange),
+                    param(c, p, 1, PUDivergingSaturationDefaultLightness),
+                    param(c, p, 2, PUDivergingSaturationDefaultSaturation),
+                    param(c, p, 3, PUDivergingSaturationDefaultHue),
+                    param(c, p, 4, PUDivergingSaturationDefaultDivergence)) };
+        break;
+    case GENCOLORMAP_PU_QUALITATIVE_HUE:
+        *g = new gencolormap_generator { Generator::PUQualitativeHue(
+                    param(c, p, 0, PUQualitativeHueDefaultHue),
+                    param(c, p, 1, PUQualitativeHueDefaultDivergence),
+                    param(c, p, 2, PUQualitativeHueDefaultLightness),
+                    param(c, p, 3, PUQualitativeHueDefaultSaturation),
+                    param(c, p, 4, PUQualitativeHueDefaultStableOrder) != 0.0f) };
+        break;
+    case GENCOLORMAP_CUBE_HELIX:
+        *g = new gencolormap_generator { Generator::CubeHelix(
+                    param(c, p, 0, CubeHelixDefaultHue),
+                    param(c, p, 1, CubeHelixDefaultRotations),
+                    param(c, p, 2, CubeHelixDefaultSaturation),
+                    param(c, p, 3, CubeHelixDefaultGamma)) };
+        break;
+    case GENCOLORMAP_MORELAND:
+        *g = new gencolormap_generator { Generator::Moreland(
+                    param_uchar(c, p, 0, MorelandDefaultR0),
+                    param_uchar(c, p, 1, MorelandDefaultG0),
+                    param_uchar(c, p, 2, MorelandDefaultB0),
+                    param_uchar(c, p, 3, MorelandDefaultR1),
+                    param_uchar(c, p, 4, MorelandDefaultG1),
+                    param_uchar(c, p, 5, MorelandDefaultB1)) };
+        break;
+    case GENCOLORMAP_MCNAMES:
+        *g = new gencolormap_generator { Generator::McNames(
+                    param(c, p, 0, McNamesDefaultPeriods)) };
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+static bool valid_format(int format)
+{
+    return format >= GENCOLORMAP_SRGB8 && format <= GENCOLORMAP_LINEAR_RGB_FLOAT;
+}
+
+static ColorMap::Output output(int format, void* colormap)
+{
+    return ColorMap::Output(static_cast<ColorMap::Format>(format), colormap);
+}
+
+extern "C" {
+
+gencolormap_generator* gencolormap_generator_create(int type, int param_count, const float* params)
+{
+    if (param_count < 0 || (param_count > 0 && !params))
+        return NULL;
+    for (int i = 0; i < param_count; i++)
+        if (!std::isfinite(params[i]))
+            return NULL;
+    try {
+        gencolormap_generator* generator;
+        if (!create_generator(type, param_count, params, &generator))
+            return NULL;
+        return generator;
+    }
+    catch (...) {
+        return NULL;
+    }
+}
+
+void gencolormap_generator_destroy(gencolormap_generator* generator)
+{
+    delete generator;
+}
+
+int gencolormap_generate(const gencolormap_generator* generator, int n, int format, void* colormap)
+{
+    return gencolormap_generate_part(generator, n, 0, n, format, colormap);
+}
+
+int gencolormap_generate_part(const gencolormap_generator* generator, int n, int first, int count,
+        int format, void* colormap)
+{
+    if (!generator || n < 1 || first < 0 || count < 0 || first > n - count
+            || !valid_format(format) || (count > 0 && !colormap))
+        return -1;
+    try {
+        return generator->generator.Generate(n, first, count, output(format, colormap));
+    }
+    catch (...) {
+        return -1;
+    }
+}
+
+int gencolormap_eval(const gencolormap_generator* generator, int count, const float* t,
+        int format, void* colormap)
+{
+    if (!generator || count < 0 || !valid_format(format) || (count > 0 && (!t || !colormap)))
+        return -1;
+    try {
+        return generator->generator.Eval(count, t, output(format, colormap));
+    }
+    catch (...) {
+        return -1;
+    }
+}
+
+int gencolormap_apply(const float* data, size_t count, float vmin, float vmax,
+        const unsigned char* srgb_colormap, int n, unsigned char* srgb_result,
+        unsigned char nan_r, unsigned char nan_g, unsigned char nan_b)
+{
+    if (n < 1 || !srgb_colormap || (count > 0 && (!data || !srgb_result)))
+        return -1;
+    try {
+        ColorMap::Apply(data, count, vmin, vmax, srgb_colormap, n, srgb_result, nan_r, nan_g, nan_b);
+        return 0;
+    }
+    catch (...) {
+        return -1;
+    }
+}
+
+static ColorMap::ShaderLanguage shader_language(int export_format)
+{
+    return (export_format == GENCOLORMAP_GLSL ? ColorMap::GLSL
+            : export_format == GENCOLORMAP_HLSL ? ColorMap::HLSL
+            : ColorMap::WGSL);
+}
+
+int gencolormap_write(FILE* f, int export_format, int n, const unsigned char* srgb_colormap)
+{
+    if (!f || n < 1 || !srgb_colormap)
+        return -1;
+    bool ok;
+    try {
+        switch (export_format) {
+        case GENCOLORMAP_CSV:
+            ok = ColorMap::WriteCSV(f, n, srgb_colormap);
+            break;
+        case GENCOLORMAP_JSON:
+            ok = ColorMap::WriteJSON(f, n, srgb_colormap);
+            break;
+        case GENCOLORMAP_PPM:
+            ok = ColorMap::WritePPM(f, n, srgb_colormap);
+            break;
+        case GENCOLORMAP_PPM_BINARY:
+            ok = ColorMap::WritePPMBinary(f, n, srgb_colormap);
+            break;
+        case GENCOLORMAP_PNG:
+            ok = ColorMap::WritePNG(f, n, srgb_colormap);
+            break;
+        case GENCOLORMAP_RGBA8:
+            ok = ColorMap::WriteRGBA8(f, n, srgb_colormap);
+            break;
+        case GENCOLORMAP_RGB565:
+            ok = ColorMap::WriteRGB565(f, n, srgb_colormap);
+            break;
+        case GENCOLORMAP_KTX2:
+            ok = ColorMap::WriteKTX2(f, n, srgb_colormap);
+            break;
+        case GENCOLORMAP_DDS:
+            ok = ColorMap::WriteDDS(f, n, srgb_colormap);
+            break;
+        case GENCOLORMAP_GLSL:
+        case GENCOLORMAP_HLSL:
+        case GENCOLORMAP_WGSL:
+            {
+                std::string s = ColorMap::ToShader(n, srgb_colormap, shader_language(export_format));
+                ok = (fwrite(s.data(), 1, s.size(), f) == s.size());
+            }
+            break;
+        default:
+            ok = false;
+            break;
+        }
+    }
+    catch (...) {
+        ok = false;
+    }
+    return ok ? 0 : -1;
+}
+
+char* gencolormap_export(int export_format, int n, const unsigned char* srgb_colormap, size_t* length)
+{
+    if (n < 1 || !srgb_colormap)
+        return NULL;
+    try {
+        std::string s;
+        switch (export_format) {
+        case GENCOLORMAP_CSV:
+            s = ColorMap::ToCSV(n, srgb_colormap);
+            break;
+        case GENCOLORMAP_JSON:
+            s = ColorMap::ToJSON(n, srgb_colormap);
+            break;
+        case GENCOLORMAP_PPM:
+            s = ColorMap::ToPPM(n, srgb_colormap);
+            break;
+        case GENCOLORMAP_GLSL:
+        case GENCOLORMAP_HLSL:
+        case GENCOLORMAP_WGSL:
+            s = ColorMap::ToShader(n, srgb_colormap, shader_language(export_format));
+            break;
+        default:
+            return NULL;
+        }
+        char* result = static_cast<char*>(std::malloc(s.size() + 1));
+        if (!result)
+            return NULL;
+        std::memcpy(result, s.c_str(), s.size() + 1);
+        if (length)
+            *length = s.size();
+        return result;
+    }
+    catch (...) {
+        return NULL;
+    }
+}
+
+int gencolormap_cache_load(const char* directory, const char* description,
+        void* data, size_t size, int* clipped)
+{
+    if (!directory || !description || (size > 0 && !data) || !clipped)
+        return -1;
+    try {
+        return ColorMap::CacheLoad(directory, description, data, size, clipped) ? 0 : -1;
+    }
+    catch (...) {
+        return -1;
+    }
+}
+
+int gencolormap_cache_store(const char* directory, const char* description,
+        const void* data, size_t size, int clipped)
+{
+    if (!directory || !description || (size > 0 && !data))
+        return -1;
+    try {
+        return ColorMap::CacheStore(directory, description, data, size, clipped) ? 0 : -1;
+    }
+    catch (...) {
+        return -1;
+    }
+}
+
+void gencolormap_use_most_saturated_table(int use)
+{
+    ColorMap::UseMostSaturatedTable(use);
+}
+
+void gencolormap_use_black_body_table(int use)
+{
+    ColorMap::UseBlackBodyTable(use);
+}
+
+void gencolormap_set_threads(int threads)
+{
+    ColorMap::SetThreads(threads);
+}
+
+}
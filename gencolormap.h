@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2024
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef GENCOLORMAP_H
+#define GENCOLORMAP_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* C interface to the color map library.
+ *
+ * All functions that compute colors write into memory provided by the caller
+ * and return the number of colors that had to be clipped to fit into sRGB,
+ * or -1 if an argument is invalid. The functions never throw exceptions.
+ * See colormap.hpp and export.hpp for details on the computations. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Output formats; see ColorMap::Format */
+enum {
+    GENCOLORMAP_SRGB8 = 0,
+    GENCOLORMAP_SRGB16 = 1,
+    GENCOLORMAP_SRGB_HALF = 2,
+    GENCOLORMAP_SRGB_FLOAT = 3,
+    GENCOLORMAP_LINEAR_RGB16 = 4,
+    GENCOLORMAP_LINEAR_RGB_HALF = 5,
+    GENCOLORMAP_LINEAR_RGB_FLOAT = 6
+};
+
+/* Color map types. The parameters of each type are passed as an array of
+ * floats in the order given here; parameters missing at the end of the array
+ * get their default values. All angles are in radians.
+ *
+ * BREWER_SEQUENTIAL:       hue, contrast, saturation, brightness, warmth
+ * BREWER_DIVERGING:        hue, divergence, contrast, saturation, brightness, warmth
+ * BREWER_QUALITATIVE:      hue, divergence, contrast, saturation, brightness,
+ *                          stable_order (0 or 1)
+ * PU_SEQUENTIAL_LIGHTNESS: lightness_range, saturation_range, saturation, hue
+ * PU_SEQUENTIAL_SATURATION: saturation_range, lightness, saturation, hue
+ * PU_SEQUENTIAL_RAINBOW:   lightness_range, saturation_range, hue, rotations, saturation
+ * PU_SEQUENTIAL_BLACK_BODY: temperature, temperature_range, lightness_range,
+ *                          saturation_range, saturation
+ * PU_SEQUENTIAL_MULTI_HUE: lightness_range, saturation_range, saturation,
+ *                          hues, hue values (hues floats), hue positions (hues floats)
+ * PU_DIVERGING_LIGHTNESS:  lightness_range, saturation_range, saturation, hue, divergence
+ * PU_DIVERGING_SATURATION: saturation_range, lightness, saturation, hue, divergence
+ * PU_QUALITATIVE_HUE:      hue, divergence, lightness, saturation, stable_order (0 or 1)
+ * CUBE_HELIX:              hue, rotations, saturation, gamma
+ * MORELAND:                sr0, sg0, sb0, sr1, sg1, sb1 (sRGB values in [0,255])
+ * MCNAMES:                 periods
+ */
+enum {
+    GENCOLORMAP_BREWER_SEQUENTIAL = 0,
+    GENCOLORMAP_BREWER_DIVERGING = 1,
+    GENCOLORMAP_BREWER_QUALITATIVE = 2,
+    GENCOLORMAP_PU_SEQUENTIAL_LIGHTNESS = 3,
+    GENCOLORMAP_PU_SEQUENTIAL_SATURATION = 4,
+    GENCOLORMAP_PU_SEQUENTIAL_RAINBOW = 5,
+    GENCOLORMAP_PU_SEQUENTIAL_BLACK_BODY = 6,
+    GENCOLORMAP_PU_SEQUENTIAL_MULTI_HUE = 7,
+    GENCOLORMAP_PU_DIVERGING_LIGHTNESS = 8,
+    GENCOLORMAP_PU_DIVERGING_SATURATION = 9,
+    GENCOLORMAP_PU_QUALITATIVE_HUE = 10,
+    GENCOLORMAP_CUBE_HELIX = 11,
+    GENCOLORMAP_MORELAND = 12,
+    GENCOLORMAP_MCNAMES = 13
+};
+
+/* Export formats */
+enum {
+    GENCOLORMAP_CSV = 0,
+    GENCOLORMAP_JSON = 1,
+    GENCOLORMAP_PPM = 2,
+    GENCOLORMAP_PPM_BINARY = 3,
+    GENCOLORMAP_PNG = 4,
+    GENCOLORMAP_KTX2 = 5,
+    GENCOLORMAP_DDS = 6,
+    GENCOLORMAP_GLSL = 7,
+    GENCOLORMAP_HLSL = 8,
+    GENCOLORMAP_WGSL = 9,
+    GENCOLORMAP_RGBA8 = 10,
+    GENCOLORMAP_RGB565 = 11
+};
+
+/* A generator for one color map type with fixed parameters; see
+ * ColorMap::Generator. A generator can be used by several threads at the
+ * same time. */
+typedef struct gencolormap_generator gencolormap_generator;
+
+/* Create a generator. Return NULL if the type is invalid, if a parameter is
+ * not finite, or if the hue count of PU_SEQUENTIAL_MULTI_HUE does not match
+ * param_count. Other parameters must be within the ranges documented in
+ * colormap.hpp. */
+gencolormap_generator* gencolormap_generator_create(int type, int param_count, const float* params);
+
+/* Destroy a generator. */
+void gencolormap_generator_destroy(gencolormap_generator* generator);
+
+/* Compute a color map with n colors in the given format. */
+int gencolormap_generate(const gencolormap_generator* generator, int n, int format, void* colormap);
+
+/* Compute only the count colors starting with color number first of a
+ * color map with n colors. */
+int gencolormap_generate_part(const gencolormap_generator* generator, int n, int first, int count,
+        int format, void* colormap);
+
+/* Compute the colors of the continuous color map at the count positions t. */
+int gencolormap_eval(const gencolormap_generator* generator, int count, const float* t,
+        int format, void* colormap);
+
+/* Map count data values to the colors of an 8 bit sRGB color map with n
+ * colors; see ColorMap::Apply. Return 0, or -1 if an argument is invalid. */
+int gencolormap_apply(const float* data, size_t count, float vmin, float vmax,
+        const unsigned char* srgb_colormap, int n, unsigned char* srgb_result,
+        unsigned char nan_r, unsigned char nan_g, unsigned char nan_b);
+
+/* Write an 8 bit sRGB color map with n colors to a file in the given export
+ * format. Binary formats need a file opened in binary mode. Return 0 on
+ * success and -1 on error. */
+int gencolormap_write(FILE* f, int export_format, int n, const unsigned char* srgb_colormap);
+
+/* Convert an 8 bit sRGB color map with n colors to a text export format
+ * (CSV, JSON, PPM, or one of the shader formats, which use the default
+ * CIEDE2000 error limit of ColorMap::ToShader). Return a null-terminated
+ * string that must be freed with free(), or NULL on error. The length is
+ * stored in length unless it is NULL. */
+char* gencolormap_export(int export_format, int n, const unsigned char* srgb_colormap, size_t* length);
+
+/* Load or store a cache entry with the given description in the cache
+ * directory; see cache.hpp. Return 0 on success and -1 on error. */
+int gencolormap_cache_load(const char* directory, const char* description,
+        void* data, size_t size, int* clipped);
+int gencolormap_cache_store(const char* directory, const char* description,
+        const void* data, size_t size, int clipped);
+
+/* Global settings; see colormap.hpp */
+void gencolormap_use_most_saturated_table(int use);
+void gencolormap_use_black_body_table(int use);
+void gencolormap_set_threads(int threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2024
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * This tool writes a header that contains all color maps with their default
+ * parameters and n=256 as precomputed sRGB tables. Programs that only need
+ * the defaults can include that header instead of generating the color maps
+ * at runtime.
+ */
+
+#include <cstdio>
+
+#include "colormap.hpp"
+
+static const int n = 256;
+
+static bool write_table(FILE* f, const char* name, const unsigned char* colormap)
+{
+    fprintf(f, "\nconstexpr unsigned char %s[3 * Size] = {", name);
+    for (int i = 0; i < n; i++) {
+        fprintf(f, "%s%3d, %3d, %3d%s",
+                i % 4 == 0 ? "\n    " : " ",
+                colormap[3 * i + 0], colormap[3 * i + 1], colormap[3 * i + 2],
+                i < n - 1 ? "," : "");
+    }
+    fprintf(f, "\n};\n");
+    return !ferror(f);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <header>\n", argv[0]);
+        return 1;
+    }
+    FILE* f = fopen(argv[1], "w");
+    if (!f) {
+        fprintf(stderr, "Cannot open %s.\n", argv[1]);
+        return 1;
+    }
+
+    fprintf(f,
+            "/* Generated by gencolormap-tables. Do not edit. */\n"
+            "\n"
+            "#ifndef COLORMAP_DEFAULTS_HPP\n"
+            "#define COLORMAP_DEFAULTS_HPP\n"
+            "\n"
+            "/* All color maps with their default parameters, as sRGB triplets. */\n"
+            "\n"
+            "namespace ColorMap {\n"
+            "\n"
+            "namespace Defaults {\n"
+            "\n"
+            "constexpr int Size = %d;\n", n);
+
+    unsigned char colormap[3 * n];
+    bool ok = true;
+    ColorMap::BrewerSequential(n, colormap);
+    ok = ok && write_table(f, "BrewerSequential", colormap);
+    ColorMap::BrewerDiverging(n, colormap);
+    ok = ok && write_table(f, "BrewerDiverging", colormap);
+    ColorMap::BrewerQualitative(n, colormap);
+    ok = ok && write_table(f, "BrewerQualitative", colormap);
+    ColorMap::PUSequentialLightness(n, colormap);
+    ok = ok && write_table(f, "PUSequentialLightness", colormap);
+    ColorMap::PUSequentialSaturation(n, colormap);
+    ok = ok && write_table(f, "PUSequentialSaturation", colormap);
+    ColorMap::PUSequentialRainbow(n, colormap);
+    ok = ok && write_table(f, "PUSequentialRainbow", colormap);
+    ColorMap::PUSequentialBlackBody(n, colormap);
+    ok = ok && write_table(f, "PUSequentialBlackBody", colormap);
+    ColorMap::PUSequentialMultiHue(n, colormap);
+    ok = ok && write_table(f, "PUSequentialMultiHue", colormap);
+    ColorMap::PUDivergingLightness(n, colormap);
+    ok = ok && write_table(f, "PUDivergingLightness", colormap);
+    ColorMap::PUDivergingSaturation(n, colormap);
+    ok = ok && write_table(f, "PUDivergingSaturation", colormap);
+    ColorMap::PUQualitativeHue(n, colormap);
+    ok = ok && write_table(f, "PUQualitativeHue", colormap);
+    ColorMap::CubeHelix(n, colormap);
+    ok = ok && write_table(f, "CubeHelix", colormap);
+    ColorMap::Moreland(n, colormap);
+    ok = ok && write_table(f, "Moreland", colormap);
+    ColorMap::McNames(n, colormap);
+    ok = ok && write_table(f, "McNames", colormap);
+
+    fprintf(f,
+            "\n"
+            "}\n"
+            "\n"
+            "}\n"
+            "\n"
+            "#endif\n");
+
+    if (fclose(f) != 0 || !ok) {
+        fprintf(stderr, "Cannot write %s.\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}
@@ -25,6 +25,8 @@
 
 #include "gui.hpp"
 
+#include <algorithm>
+
 #include <QApplication>
 #include <QGuiApplication>
 #include <QGridLayout>
@@ -38,13 +40,64 @@
 #include <QMessageBox>
 #include <QRadioButton>
 #include <QButtonGroup>
+#include <QStatusBar>
+#include <QSlider>
+#include <QTimer>
+#include <QPainter>
+#include <QtConcurrent>
 
 #include "colormapwidgets.hpp"
 #include "testwidget.hpp"
 #include "export.hpp"
+#include "colormap.hpp"
+
+
+// While a slider is dragged, the preview shows a color map with this number
+// of colors and a test image with a fraction of the full resolution. The full
+// color map is computed when the slider is released or does not move for
+// full_update_delay milliseconds.
+static const int preview_colors = 64;
+static const int preview_test_image_divisor = 4;
+static const int full_update_delay = 250;
+
+// Draw the CIEDE2000 steps of a color map as a curve over its test image,
+// with the mean step as a dashed line, and mark the clipped colors (if their
+// flags are known) at the top of the image
+static void draw_metrics(QImage& image, const QVector<float>& delta_e2000,
+        float mean_step, const QVector<unsigned char>& clipped_flags)
+{
+    int steps = delta_e2000.size();
+    if (steps < 1)
+        return;
+    float max_step = *std::max_element(delta_e2000.begin(), delta_e2000.end());
+    if (max_step <= 0.0f)
+        return;
+    // The test image maps x in [0,w-1] to the colors [0,n-1]; the curve uses
+    // 80% of the image height
+    float w = image.width() - 1;
+    float h = image.height() - 1;
+    auto x = [=](float i) { return i / steps * w; };
+    auto y = [=](float step) { return h - 0.8f * h * step / max_step; };
+    QPolygonF curve;
+    for (int i = 0; i < steps; i++)
+        curve << QPointF(x(i + 0.5f), y(delta_e2000[i]));
 
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(Qt::white, 3.0));
+    painter.drawPolyline(curve);
+    painter.setPen(QPen(Qt::black, 1.0));
+    painter.drawPolyline(curve);
+    painter.setPen(QPen(Qt::black, 1.0, Qt::DashLine));
+    painter.drawLine(QPointF(0.0f, y(mean_step)), QPointF(w, y(mean_step)));
+    painter.setPen(QPen(Qt::red, 2.0));
+    for (int i = 0; i < clipped_flags.size(); i++) {
+        if (clipped_flags[i])
+            painter.drawLine(QPointF(x(i), 0.0f), QPointF(x(i), h / 16.0f));
+    }
+}
 
-GUI::GUI()
+GUI::GUI() : _update_pending(false), _full_update_requested(false)
 {
     setWindowTitle("Generate Color Map");
     setWindowIcon(QIcon(":res/gencolormap-logo-512.png"));
@@ -197,17 +250,33 @@ GUI::GUI()
     connect(edit_copy_act, SIGNAL(triggered()), this, SLOT(edit_copy()));
     edit_menu->addAction(edit_copy_act);
 
+    QMenu* view_menu = menuBar()->addMenu("&View");
+    _view_metrics_act = new QAction("Show &Delta E profile", this);
+    _view_metrics_act->setCheckable(true);
+    connect(_view_metrics_act, SIGNAL(toggled(bool)), this, SLOT(update()));
+    view_menu->addAction(_view_metrics_act);
+
     QMenu* help_menu = menuBar()->addMenu("&Help");
     QAction* help_about_act = new QAction("&About", this);
     connect(help_about_act, SIGNAL(triggered()), this, SLOT(help_about()));
     help_menu->addAction(help_about_act);
 
+    connect(&_update_watcher, SIGNAL(finished()), this, SLOT(updateFinished()));
+    _sliders = findChildren<QSlider*>();
+    for (QSlider* slider : _sliders)
+        connect(slider, SIGNAL(sliderReleased()), this, SLOT(fullUpdate()));
+    _full_update_timer = new QTimer(this);
+    _full_update_timer->setSingleShot(true);
+    _full_update_timer->setInterval(full_update_delay);
+    connect(_full_update_timer, SIGNAL(timeout()), this, SLOT(fullUpdate()));
+
     show();
     update();
 }
 
 GUI::~GUI()
 {
+    _update_watcher.waitForFinished();
 }
 
 ColorMapWidget* GUI::currentWidget()
@@ -219,11 +288,165 @@ ColorMapWidget* GUI::currentWidget()
 void GUI::update()
 {
     _reference_label->setText(currentWidget()->reference());
-    int clipped;
-    QVector<unsigned char> colormap = currentWidget()->colorMap(&clipped);
-    _clipped_label->setText(QString("Colors clipped: %1").arg(clipped));
-    _colormap_label->setPixmap(QPixmap::fromImage(currentWidget()->colorMapImage(colormap, 32, _colormap_label->height())));
-    _test_widget->update(colormap);
+    if (_update_watcher.isRunning()) {
+        // Only the latest values are computed once the current computation
+        // is finished; all changes in between are skipped.
+        _update_pending = true;
+        return;
+    }
+    _update_pending = false;
+
+    // Collect everything on the GUI thread, then compute the color map and
+    // the images in the background
+    ColorMapWidget* widget = currentWidget();
+    unsigned long long version = widget->colorMapVersion();
+    bool cached = widget->colorMapCached();
+    int cached_clipped = 0;
+    QVector<unsigned char> cached_colormap;
+    QVector<unsigned char> cached_clipped_flags;
+    if (cached) {
+        cached_colormap = widget->colorMap(&cached_clipped);
+        if (_last_full_update.generator && _last_full_update.widget == widget
+                && _last_full_update.version == version)
+            cached_clipped_flags = _last_full_update.clipped_flags;
+    }
+    int n;
+    ColorMap::Generator generator = widget->generator(n);
+    int colormap_height = _colormap_label->height();
+    QSize test_size = _test_widget->imageSize();
+
+    // Compute only a coarse preview while a slider is being dragged
+    bool dragging = false;
+    for (QSlider* slider : _sliders)
+        dragging = dragging || slider->isSliderDown();
+    bool coarse = (dragging && !_full_update_requested && !cached && n > preview_colors);
+    if (coarse)
+        _full_update_timer->start();
+    else
+        _full_update_requested = false;
+    bool show_metrics = _view_metrics_act->isChecked();
+
+    // A full color map is updated from the previous full color map of the
+    // same widget, so that colors which cannot have changed are reused
+    GUIUpdateResult previous;
+    if (!cached && !coarse && _last_full_update.generator
+            && _last_full_update.widget == widget && _last_full_update.n == n)
+        previous = _last_full_update;
+
+    GUIUpdateBuffers* buffers = &_update_buffers;
+    _update_watcher.setFuture(QtConcurrent::run([=]() {
+        GUIUpdateResult r;
+        r.widget = widget;
+        r.version = version;
+        r.computed = !cached;
+        r.coarse = coarse;
+        if (cached) {
+            r.colormap = cached_colormap;
+            r.clipped = cached_clipped;
+            r.clipped_flags = cached_clipped_flags;
+        } else if (coarse) {
+            // Sample the continuous color map
+            float t[preview_colors];
+            for (int i = 0; i < preview_colors; i++)
+                t[i] = (i + 0.5f) / preview_colors;
+            r.colormap.resize(3 * preview_colors);
+            ColorMap::ResetStatistics();
+            r.clipped = generator.Eval(preview_colors, t, r.colormap.data());
+            r.statistics = ColorMap::GetStatistics();
+        } else {
+            r.generator = std::make_shared<const ColorMap::Generator>(generator);
+            r.n = n;
+            r.colormap = std::move(buffers->colormap);
+            r.clipped_flags = std::move(buffers->clipped_flags);
+            r.colormap.resize(3 * n);
+            r.clipped_flags.resize(n);
+            ColorMap::ResetStatistics();
+            if (previous.generator) {
+                std::copy(previous.colormap.constBegin(), previous.colormap.constEnd(), r.colormap.begin());
+                std::copy(previous.clipped_flags.constBegin(), previous.clipped_flags.constEnd(), r.clipped_flags.begin());
+                r.clipped = generator.Update(n, r.colormap.data(), r.clipped_flags.data(), *previous.generator);
+            } else {
+                r.clipped = generator.Generate(n, r.colormap.data(), r.clipped_flags.data());
+            }
+            r.statistics = ColorMap::GetStatistics();
+        }
+        r.colormap_image = std::move(buffers->colormap_image);
+        ColorMapWidget::colorMapImage(r.colormap, 32, colormap_height, r.colormap_image);
+        r.test_image = std::move(buffers->test_image);
+        if (coarse) {
+            ColorMapTestWidget::image(r.colormap,
+                    test_size.width() / preview_test_image_divisor,
+                    test_size.height() / preview_test_image_divisor,
+                    buffers->preview_image);
+            if (r.test_image.size() != test_size || r.test_image.format() != QImage::Format_RGB32)
+                r.test_image = QImage(test_size, QImage::Format_RGB32);
+            QPainter painter(&r.test_image);
+            painter.drawImage(r.test_image.rect(), buffers->preview_image);
+        } else {
+            ColorMapTestWidget::image(r.colormap, test_size.width(), test_size.height(), r.test_image);
+        }
+        r.metrics_computed = (show_metrics && !coarse);
+        if (r.metrics_computed) {
+            int colors = r.colormap.size() / 3;
+            buffers->delta_e2000.resize(colors - 1);
+            r.metrics = ColorMap::ComputeMetrics(colors, r.colormap.constData(), NULL, buffers->delta_e2000.data());
+            draw_metrics(r.test_image, buffers->delta_e2000, r.metrics.delta_e2000.mean, r.clipped_flags);
+        }
+        return r;
+    }));
+}
+
+void GUI::fullUpdate()
+{
+    _full_update_timer->stop();
+    _full_update_requested = true;
+    update();
+}
+
+void GUI::updateFinished()
+{
+    // Take the result instead of copying it, so that the future does not
+    // keep references to the buffers that are reused below
+    GUIUpdateResult r = _update_watcher.future().takeResult();
+    if (!r.coarse) {
+        // Export and copy use this color map without computing it again
+        r.widget->setCachedColorMap(r.version, r.colormap, r.clipped);
+        QString text = QString("Colors clipped: %1").arg(r.clipped);
+        if (r.metrics_computed) {
+            const ColorMap::MetricsSteps& st = r.metrics.delta_e2000;
+            text += QString(". CIEDE2000 steps: mean %1, min %2, max %3, variation %4%.")
+                .arg(st.mean, 0, 'f', 2)
+                .arg(st.min, 0, 'f', 2)
+                .arg(st.max, 0, 'f', 2)
+                .arg(st.variation * 100.0f, 0, 'f', 1);
+        }
+        _clipped_label->setText(text);
+    }
+    if (r.computed && ColorMap::StatisticsEnabled()) {
+        const ColorMap::Statistics& s = r.statistics;
+        statusBar()->showMessage(QString("Entries %1 ms (uniform LC %2 ms, max. saturation %3 ms), "
+                    "conversion %4 ms, %5 uniform LC solves, %6 fallbacks, %7 transcendental calls")
+                .arg(s.entries_time * 1e3, 0, 'f', 3)
+                .arg(s.uniform_lc_time * 1e3, 0, 'f', 3)
+                .arg(s.s_max_time * 1e3, 0, 'f', 3)
+                .arg(s.conversion_time * 1e3, 0, 'f', 3)
+                .arg(s.uniform_lc_solves)
+                .arg(s.uniform_lc_fallbacks)
+                .arg(s.transcendental_calls));
+    }
+    _colormap_label->setPixmap(QPixmap::fromImage(r.colormap_image));
+    _update_buffers.colormap_image = std::move(r.colormap_image);
+    _test_widget->swapImage(r.test_image);
+    _update_buffers.test_image = std::move(r.test_image);
+    if (r.generator) {
+        // The previous full color map is no longer needed once both this
+        // and the widget cache refer to the new one
+        _update_buffers.colormap = std::move(_last_full_update.colormap);
+        _update_buffers.clipped_flags = std::move(_last_full_update.clipped_flags);
+        _last_full_update = r;
+    }
+    if (_update_pending)
+        update();
 }
 
 void GUI::file_export()
@@ -233,7 +456,7 @@ void GUI::file_export()
         QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
         QVector<unsigned char> colormap = currentWidget()->colorMap();
         if (_export_format_png_button->isChecked()) {
-            currentWidget()->colorMapImage(colormap, 0, 1).save(name, "png");
+            ColorMapWidget::colorMapRowImage(colormap).save(name, "png");
         } else {
             QFile file(name);
             if (file.open(QIODevice::WriteOnly)) {
@@ -279,7 +502,7 @@ void GUI::edit_copy()
 void GUI::help_about()
 {
     QMessageBox::about(this, "About",
-                "<p>gencolormap version 2.4<br>"
+                "<p>gencolormap version " GENCOLORMAP_VERSION "<br>"
                 "   <a href=\"https://marlam.de/gencolormap\">https://marlam.de/gencolormap</a></p>"
                 "<p>Copyright (C) 2024<br>"
                 "   <a href=\"https://www.cg.informatik.uni-siegen.de/\">"
@@ -26,6 +26,11 @@
 #define GUI_HPP
 
 #include <QMainWindow>
+#include <QFutureWatcher>
+#include <QVector>
+#include <QImage>
+
+#include "colormap.hpp"
 
 class ColorMapWidget;
 class ColorMapBrewerSequentialWidget;
@@ -46,7 +51,47 @@ class ColorMapTestWidget;
 class QTabWidget;
 class QLabel;
 class QRadioButton;
+class QSlider;
+class QTimer;
+class QAction;
+
+// The result of a color map computation in the background
+class GUIUpdateResult
+{
+public:
+    ColorMapWidget* widget;
+    unsigned long long version;
+    bool computed;
+    bool coarse;
+    QVector<unsigned char> colormap;
+    int clipped;
+    // For full color maps: the generator, n, and the clipped flag of each
+    // color, so that the next color map can be updated from this one
+    std::shared_ptr<const ColorMap::Generator> generator;
+    int n;
+    QVector<unsigned char> clipped_flags;
+    bool metrics_computed;
+    ColorMap::Metrics metrics;
+    ColorMap::Statistics statistics;
+    QImage colormap_image;
+    QImage test_image;
+};
 
+// Buffers that are reused from one update to the next, so that updating
+// the same color map with different parameters allocates no new memory.
+// While a background computation runs, only that computation uses them;
+// the images and color map it returns are handed back when they are no
+// longer displayed.
+class GUIUpdateBuffers
+{
+public:
+    QVector<unsigned char> colormap;
+    QVector<unsigned char> clipped_flags;
+    QVector<float> delta_e2000;
+    QImage colormap_image;
+    QImage preview_image;
+    QImage test_image;
+};
 
 class GUI : public QMainWindow
 {
@@ -83,11 +128,21 @@ private:
     QRadioButton* _export_format_ppm_button;
     QRadioButton* _export_format_csv_button;
     QRadioButton* _export_format_json_button;
+    QAction* _view_metrics_act;
+    QFutureWatcher<GUIUpdateResult> _update_watcher;
+    bool _update_pending;
+    QList<QSlider*> _sliders;
+    QTimer* _full_update_timer;
+    bool _full_update_requested;
+    GUIUpdateResult _last_full_update;
+    GUIUpdateBuffers _update_buffers;
 
     ColorMapWidget* currentWidget();
 
 private slots:
     void update();
+    void fullUpdate();
+    void updateFinished();
 
     void file_export();
     void edit_reset();
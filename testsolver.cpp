@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2024
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * This test checks that lch_compute_uniform_lc() returns bit-identical
+ * results to the original solver, which is kept here as the reference. The
+ * solver is a static function, so this file includes colormap.cpp instead of
+ * linking against the library.
+ */
+
+#include <random>
+
+#include "colormap.cpp"
+
+namespace ColorMap {
+
+// The original solver. Do not optimize this; it defines the expected results.
+static triplet lch_compute_uniform_lc_reference(float t,
+        float t0, float t1,
+        triplet lch0, triplet lch1, float D,
+        float hue)
+{
+    // t is in [0,1]; s is in [0,1] but relative to [t0,t1]
+    float s = (t - t0) / (t1 - t0);
+
+    triplet lcht;
+    lcht.h = hue;
+    lcht.l = (1.0f - s) * lch0.l + s * lch1.l;
+
+    // compute four solutions for lcht.c based on two conditions:
+    float lcht_cs[4];
+    // 1) the distance between lcht and lch0 is (s * D)
+    float tmp00 = lch0.c * std::cos(lcht.h - lch0.h);
+    float tmp01 = std::max(0.0f, sqr(tmp00) - sqr(lcht.l - lch0.l) - sqr(lch0.c) + sqr(s * D));
+    lcht_cs[0] = tmp00 + std::sqrt(tmp01);
+    lcht_cs[1] = tmp00 - std::sqrt(tmp01);
+    // 2) the distance between lcht and lch1 is ((1-s) * D)
+    float tmp10 = lch1.c * std::cos(lcht.h - lch1.h);
+    float tmp11 = std::max(0.0f, sqr(tmp10) - sqr(lcht.l - lch1.l) - sqr(lch1.c) + sqr((1.0f - s) * D));
+    lcht_cs[2] = tmp10 + std::sqrt(tmp11);
+    lcht_cs[3] = tmp10 - std::sqrt(tmp11);
+
+    // find the best solution
+    float min_c = std::min(lch0.c, lch1.c);
+    float max_c = std::max(lch0.c, lch1.c);
+    float min_solution_error = 9999.9f;
+    int min_solution_error_index = -1;
+    for (int i = 0; i < 4; i++) {
+        if (lcht_cs[i] < min_c || lcht_cs[i] > max_c) {
+            // this solution is invalid
+        } else {
+            // solution error is sum of the deviations from condition 1 and 2
+            float dist_lch0_lcht = lch_distance(lch0, triplet(lcht.l, lcht_cs[i], lcht.h));
+            float dist_lch1_lcht = lch_distance(lch1, triplet(lcht.l, lcht_cs[i], lcht.h));
+            float solution_error = std::abs(dist_lch0_lcht - s * D) + std::abs(dist_lch1_lcht - (1.0f - s) * D);
+            if (min_solution_error_index == -1 || solution_error < min_solution_error) {
+                min_solution_error = solution_error;
+                min_solution_error_index = i;
+            }
+        }
+    }
+    if (min_solution_error_index == -1) {
+        lcht.c = 0.5f * (lch0.c + lch1.c);
+    } else {
+        lcht.c = lcht_cs[min_solution_error_index];
+    }
+
+    return lcht;
+}
+
+}
+
+using namespace ColorMap;
+
+int main()
+{
+    // Fixed seed, so that failures are reproducible
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    const float intervals[3][2] = { { 0.0f, 0.5f }, { 0.5f, 1.0f }, { 0.0f, 1.0f } };
+    const int cases = 1000000;
+    int failures = 0;
+    for (int i = 0; i < cases; i++) {
+        triplet lch0(100.0f * uniform(rng), 180.0f * uniform(rng), 6.0f * pi * uniform(rng) - twopi);
+        triplet lch1(100.0f * uniform(rng), 180.0f * uniform(rng), 6.0f * pi * uniform(rng) - twopi);
+        // Cover the special cases of equal or zero chroma, too
+        if (i % 7 == 0)
+            lch1.c = lch0.c;
+        else if (i % 11 == 0)
+            lch0.c = 0.0f;
+        const float* interval = intervals[i % 3];
+        float t = interval[0] + (interval[1] - interval[0]) * uniform(rng);
+        float hue = 6.0f * pi * uniform(rng) - twopi;
+        // The generators pass the distance between the anchors; also check
+        // other values, for which the fallback is taken more often
+        float D = lch_distance(lch0, lch1);
+        if (i % 5 == 0)
+            D *= 2.0f * uniform(rng);
+        triplet expected = lch_compute_uniform_lc_reference(t, interval[0], interval[1], lch0, lch1, D, hue);
+        triplet result = lch_compute_uniform_lc(t, interval[0], interval[1], lch0, lch1, D, hue);
+        if (std::memcmp(&expected, &result, sizeof(triplet)) != 0) {
+            if (failures < 10) {
+                fprintf(stderr, "Case %d: expected (%a, %a, %a), got (%a, %a, %a)\n", i,
+                        expected.l, expected.c, expected.h, result.l, result.c, result.h);
+            }
+            failures++;
+        }
+    }
+    printf("%d of %d cases differ from the reference solver\n", failures, cases);
+    return failures == 0 ? 0 : 1;
+}
@@ -24,7 +24,10 @@
 #include <cmath>
 
 #include <QGuiApplication>
-#include <QColor>
+#include <QImage>
+#include <QMutex>
+#include <QPainter>
+#include <QVarLengthArray>
 
 #include "testwidget.hpp"
 
@@ -47,26 +50,102 @@ ColorMapTestWidget::~ColorMapTestWidget()
 {
 }
 
-void ColorMapTestWidget::update(const QVector<unsigned char>& colormap)
+QSize ColorMapTestWidget::imageSize() const
 {
-    QImage img(W * qApp->devicePixelRatio(), H * qApp->devicePixelRatio(), QImage::Format_RGB32);
-    for (int y = 0; y < img.height(); y++) {
-        QRgb* scanline = reinterpret_cast<QRgb*>(img.scanLine(y));
-        float v = 1.0f - (y / (img.height() - 1.0f));
-        for (int x = 0; x < img.width(); x++) {
-            float u = x / (img.width() - 1.0f);
+    return QSize(W * qApp->devicePixelRatio(), H * qApp->devicePixelRatio());
+}
+
+// The color map indices of the test image pixels depend only on the image
+// size and the number of colors, so they are computed only when one of these
+// changes. The image function may be called from several threads
+// (though not at the same time in practice), hence the mutex.
+class ColorMapTestIndices
+{
+public:
+    QMutex mutex;
+    int width = 0, height = 0, n = 0;
+    QVector<int> indices;
+
+    QVector<int> get(int w, int h, int colors)
+    {
+        QMutexLocker locker(&mutex);
+        if (w != width || h != height || colors != n) {
+            indices.resize(w * h);
             // Test image formula
-            float ramp = u;
-            float modulation = 0.05f * std::sin(W / 8 * twopi * u);
-            float value = ramp + v * v * modulation;
-            // Applying colormap
-            int i = std::round(value * (colormap.size() / 3 - 1));
-            if (i < 0)
-                i = 0;
-            else if (i >= colormap.size() / 3)
-                i = colormap.size() / 3 - 1;
-            scanline[x] = QColor(colormap[3 * i + 0], colormap[3 * i + 1], colormap[3 * i + 2]).rgb();
+            QVector<float> modulation(w);
+            for (int x = 0; x < w; x++) {
+                float u = x / (w - 1.0f);
+                modulation[x] = 0.05f * std::sin(W / 8 * twopi * u);
+            }
+            for (int y = 0; y < h; y++) {
+                float v = 1.0f - (y / (h - 1.0f));
+                for (int x = 0; x < w; x++) {
+                    float u = x / (w - 1.0f);
+                    float ramp = u;
+                    float value = ramp + v * v * modulation[x];
+                    int i = std::round(value * (colors - 1));
+                    if (i < 0)
+                        i = 0;
+                    else if (i >= colors)
+                        i = colors - 1;
+                    indices[y * w + x] = i;
+                }
+            }
+            width = w;
+            height = h;
+            n = colors;
         }
+        return indices;
+    }
+};
+
+QImage ColorMapTestWidget::image(const QVector<unsigned char>& colormap, int width, int height)
+{
+    QImage img;
+    image(colormap, width, height, img);
+    return img;
+}
+
+void ColorMapTestWidget::image(const QVector<unsigned char>& colormap, int width, int height, QImage& img)
+{
+    static ColorMapTestIndices test_indices;
+    int n = colormap.size() / 3;
+    QVector<int> indices = test_indices.get(width, height, n);
+    // Typical color map sizes fit on the stack. Larger ones (the GUI allows up
+    // to 10240 colors) fall back to the heap, which costs little compared to
+    // generating that many colors.
+    QVarLengthArray<QRgb, 1024> lut(n);
+    for (int i = 0; i < n; i++)
+        lut[i] = qRgb(colormap[3 * i + 0], colormap[3 * i + 1], colormap[3 * i + 2]);
+
+    // Applying colormap
+    if (img.width() != width || img.height() != height || img.format() != QImage::Format_RGB32)
+        img = QImage(width, height, QImage::Format_RGB32);
+    for (int y = 0; y < height; y++) {
+        QRgb* scanline = reinterpret_cast<QRgb*>(img.scanLine(y));
+        const int* row = indices.constData() + y * width;
+        for (int x = 0; x < width; x++)
+            scanline[x] = lut[row[x]];
     }
-    setPixmap(QPixmap::fromImage(img));
+}
+
+void ColorMapTestWidget::update(const QVector<unsigned char>& colormap)
+{
+    QSize size = imageSize();
+    QImage img;
+    image(colormap, size.width(), size.height(), img);
+    swapImage(img);
+}
+
+void ColorMapTestWidget::swapImage(QImage& img)
+{
+    _image.swap(img);
+    QWidget::update();
+}
+
+void ColorMapTestWidget::paintEvent(QPaintEvent*)
+{
+    // Same placement as a QLabel pixmap: left aligned, vertically centered
+    QPainter painter(this);
+    painter.drawImage(QPoint(0, (height() - _image.height()) / 2), _image);
 }
@@ -25,6 +25,7 @@
 #define TESTWIDGET_HPP
 
 #include <QLabel>
+#include <QImage>
 #include <QVector>
 
 class ColorMapTestWidget : public QLabel
@@ -35,7 +36,27 @@ public:
     ColorMapTestWidget();
     ~ColorMapTestWidget();
 
+    /* Get the size of the test image for this widget */
+    QSize imageSize() const;
+
+    /* Apply the color map to a test image of the given size. This does not
+     * refer to a widget, so it can be used in other threads. */
+    static QImage image(const QVector<unsigned char>& colormap, int width, int height);
+    /* Same, but render into an existing image. Its pixel buffer is reused if
+     * it already has the requested size and format and is not shared. */
+    static void image(const QVector<unsigned char>& colormap, int width, int height, QImage& img);
+
     void update(const QVector<unsigned char>& colormap);
+
+    /* Show the given test image, and return the previously shown image in
+     * img so that its buffer can be reused for the next one. */
+    void swapImage(QImage& img);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+
+private:
+    QImage _image;
 };
 
 #endif